@@ -1,4 +1,251 @@
 #pragma once
 #include "graph.h"
+#include "profile.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <tuple>
 
-void constructCDT( Graph *graph );
\ No newline at end of file
+// Phases of constructCDT, in execution order
+enum class CDTPhase
+{
+	Normalize,
+	BinSort,
+	Insertion,
+	Legalization,
+	Constraints,
+	Refinement,
+	Extraction,
+	Count
+};
+
+const char *phaseName( CDTPhase phase );
+
+struct CDTPhaseStats {
+	double seconds = 0;
+	// Process-wide peak resident set size (KiB) observed when the phase finished
+	long peakRssKb = 0;
+};
+
+struct CDTStats {
+	std::array<CDTPhaseStats, static_cast<size_t>( CDTPhase::Count )> phases{};
+	size_t nodes = 0, triangles = 0, edges = 0;
+	// Steiner points added by refinement, included in nodes
+	size_t steiner = 0;
+	// Storage the run picked, see CDTPrecision and CDTIndexWidth, and what it costs per node and per triangle
+	bool floatCoordinates = false, wideIndices = false;
+	size_t nodeBytes = 0, triangleBytes = 0;
+	// Event counters and timed spans of the run; routeNets adds its rounds and workers to the same profile
+	Profile profile;
+
+	CDTPhaseStats &operator[]( CDTPhase phase ) { return phases[static_cast<size_t>( phase )]; }
+	const CDTPhaseStats &operator[]( CDTPhase phase ) const { return phases[static_cast<size_t>( phase )]; }
+};
+
+// Order in which the serial Delaunay build inserts the nodes. Each new node is located by walking from the last
+// triangle created, so consecutive nodes should be close.
+enum class InsertionOrder
+{
+	// Serpentine rows of about n^0.25 x n^0.25 bins
+	Bins,
+	// Along a Hilbert curve, which keeps clustered pins together
+	Hilbert,
+	// Biased randomized insertion order: random rounds, each about half the size of the next, each along a Hilbert
+	// curve. Avoids the worst cases of a fixed curve on adversarial inputs.
+	Brio
+};
+
+// Delaunay refinement of the free space once the constraints are in: Steiner points are added until every free
+// triangle meets the targets below. All of them are off by default.
+struct RefineOptions {
+	// Larger minAngle values are clamped to this. Past it, Ruppert's refinement can keep splitting forever.
+	static constexpr double maxMinAngle = 30;
+	// Smallest angle wanted, in degrees. Refinement is guaranteed to finish for bounds up to about 20.7 degrees and
+	// usually does up to maxMinAngle.
+	double minAngle = 0;
+	// Largest area wanted, in graph units
+	double maxArea = 0;
+	// Longest edge wanted for a triangle whose centroid is at (x, y), in graph units
+	std::function<double( double x, double y )> sizeField;
+	// Upper bound on the Steiner points added
+	size_t maxSteiner = std::numeric_limits<size_t>::max();
+
+	bool enabled() const { return minAngle > 0 || maxArea > 0 || sizeField; }
+};
+
+// Storage types of the triangulation engine. Predicates and constructions always evaluate in double precision,
+// whatever the coordinates are stored as.
+enum class CDTPrecision
+{
+	// Double. Float is only used when asked for, it changes the triangulation wherever rounding does.
+	Auto,
+	Double,
+	// Coordinates float cannot hold are rounded. Ignored when refining, Steiner points need full precision.
+	Float
+};
+enum class CDTIndexWidth
+{
+	// 64 bits only when the triangles of the graph would not fit in 32
+	Auto,
+	// Half the triangle record, limits a run to about 2^31 nodes
+	Bits32,
+	Bits64
+};
+
+struct CDTOptions {
+	// Worker threads for the Delaunay build. With more than one, the nodes are cut into vertical strips that are
+	// triangulated concurrently and then merged. The result is a valid Delaunay triangulation with the same constraints
+	// as the serial build. Where four or more points are cocircular the two may pick different diagonals.
+	unsigned threads = 1;
+	InsertionOrder order = InsertionOrder::Hilbert;
+	// Worker threads computing the insertion order of the serial build
+	unsigned sortThreads = 1;
+	// Optional progress and cancellation, reported per phase and during the insertion of the serial build
+	JobControl *control = nullptr;
+	RefineOptions refine;
+	// Storage of constructCDT; DynamicCDT, routeNets and tiled construction always use double and 32 bits
+	CDTPrecision precision = CDTPrecision::Auto;
+	CDTIndexWidth indexWidth = CDTIndexWidth::Auto;
+};
+
+template<typename Scalar, typename Index>
+struct BasicCDTBuffers;
+template<typename Scalar, typename Index>
+struct BasicCDTHelper;
+
+// Buffers kept between triangulations. A run borrows them and hands them back with whatever capacity it grew
+// them to, so repeated runs of similar size stop allocating. A workspace serves one run at a time: threads
+// triangulating concurrently each need their own, but it may move between threads from one run to the next.
+class CDTWorkspace
+{
+public:
+	CDTWorkspace();
+	CDTWorkspace( CDTWorkspace && ) noexcept;
+	CDTWorkspace &operator=( CDTWorkspace && ) noexcept;
+	~CDTWorkspace();
+	// Bytes reserved by all buffers
+	size_t capacityBytes() const;
+
+private:
+	template<typename Scalar, typename Index>
+	friend struct BasicCDTHelper;
+	// One set per storage type, made by the first run that uses it
+	std::tuple<std::unique_ptr<BasicCDTBuffers<double, uint32_t>>, std::unique_ptr<BasicCDTBuffers<float, uint32_t>>,
+			   std::unique_ptr<BasicCDTBuffers<double, uint64_t>>, std::unique_ptr<BasicCDTBuffers<float, uint64_t>>>
+		buffers;
+};
+
+// Returns false if options.control cancels the run, the CDT edges of the graph are left as they were
+bool constructCDT( Graph *graph, CDTStats *stats = nullptr, const CDTOptions &options = {}, CDTWorkspace *workspace = nullptr );
+
+struct TiledCDTOptions {
+	// Side of the square tiles in graph units. Memory follows the nodes of one tile and its margin plus those of the
+	// stitch, which has the vertices along every seam, so smaller tiles make a larger stitch.
+	double tileSize = 1000;
+	// Border triangulated around every tile, as a fraction of tileSize. Triangles whose circumcircle does not fit
+	// in it are left to the stitch, so a thin margin makes the stitch larger.
+	double margin = 0.25;
+	// Used for every tile and for the stitch. Refinement is not supported in tiles and is ignored.
+	CDTOptions cdt;
+};
+
+struct TiledCDTStats {
+	// Phases and counters summed over the tiles and the stitch; nodes, triangles and edges are those of the result
+	CDTStats cdt;
+	size_t tiles = 0;
+	// Nodes of the largest tile and of the stitch, which together bound the memory used. The stitch is not tiled
+	// itself, so watch stitchNodes on dies with many tiles.
+	size_t maxTileNodes = 0, stitchNodes = 0;
+	// Free triangles settled by the tiles and by the stitch
+	size_t tileTriangles = 0, stitchTriangles = 0;
+	long peakRssKb = 0;
+	double seconds = 0;
+};
+
+// Out-of-core constructCDT for layouts whose triangulation does not fit in memory. The die is triangulated one
+// overlapping tile at a time and the CDT edges are streamed into the layout file at path, after the obstacles and
+// nets of graph; graph itself is left as it is. Returns false if options.cdt.control cancels the run or the file
+// cannot be written.
+bool constructCDTTiled( const Graph &graph, const char *path, TiledCDTStats *stats = nullptr, const TiledCDTOptions &options = {} );
+
+struct RouteOptions {
+	// Wire pitch in graph units, an edge of length l holds floor( l / pitch ) wires and at least one
+	double pitch = 1;
+	// Extra cost factor for a used edge, growing with its wires up to this much when it is full
+	double congestionWeight = 1;
+	// Extra cost factor for crossing a full edge. Full edges stay usable so every connected net gets a route.
+	double overflowPenalty = 1;
+	// Scale of the distance-to-goal estimate. 1 keeps A* exact on the channel costs but floods the die once it is
+	// congested; the default matches the cost of crossing full edges, so searches stay near the straight line and
+	// the funnel straightens what is left.
+	double heuristicWeight = 4;
+	// Worker threads, used for the triangulation and for routing nets concurrently
+	unsigned threads = 1;
+	// Negotiated congestion rounds after the first pass: nets through overfull edges are ripped up and routed again
+	// while those edges carry a history cost that keeps growing as long as they stay overfull
+	unsigned rounds = 3;
+	// History cost added to an edge per round, per wire over its capacity relative to that capacity
+	double historyWeight = 0.5;
+	// Optional progress and cancellation, passed on to the triangulation
+	JobControl *control = nullptr;
+	// Refinement of the triangulation before routing. Capacities follow edge lengths, so a bounded size keeps them
+	// meaningful in the open space between distant obstacles.
+	RefineOptions refine;
+};
+
+struct RouteStats {
+	CDTStats cdt;
+	size_t routed = 0, unrouted = 0, expanded = 0, overflowEdges = 0;
+	// Negotiation rounds run and nets routed again in them
+	size_t rounds = 0, rerouted = 0;
+	double wirelength = 0, seconds = 0;
+};
+
+// Triangulate graph like constructCDT, then route every net over the triangulation and store the routes.
+// Returns false if options.control cancels the run; the routes are only stored by a complete run.
+bool routeNets( Graph *graph, RouteStats *stats = nullptr, const RouteOptions &options = {}, CDTWorkspace *workspace = nullptr );
+
+using CDTHelper = BasicCDTHelper<double, uint32_t>;
+
+// Triangle of a DynamicCDT holding a query point
+struct CDTFace {
+	// Counter-clockwise, in graph coordinates
+	std::array<Point, 3> corners;
+	// False inside an obstacle or outside the die
+	bool free;
+};
+
+// Triangulation kept alive next to its Graph. It subscribes to the graph and follows every edit locally: inserted
+// points only re-legalize their cavity, removed points re-triangulate their star, and obstacles add or drop the
+// constraints of their sides, so an edit costs time proportional to the area it changes.
+// The CDT edges of the graph are only rewritten by publish().
+class DynamicCDT
+{
+public:
+	explicit DynamicCDT( Graph *graph, CDTStats *stats = nullptr, const CDTOptions &options = {} );
+	~DynamicCDT();
+	DynamicCDT( const DynamicCDT & ) = delete;
+	DynamicCDT &operator=( const DynamicCDT & ) = delete;
+	// Store the current CDT edges in the graph
+	void publish();
+	// Nodes allocated so far, live or waiting to be recycled. Stays bounded by the most points alive at once.
+	size_t nodeCapacity() const;
+	// Triangle of the current CDT containing (x, y). Points on an edge may get either side.
+	CDTFace locate( double x, double y );
+	// Route the given nets over the current CDT in order and return their polylines, empty for nets whose pins are
+	// not connected. Each net sees the wires of the nets before it, like the first pass of routeNets; nothing is
+	// stored in the graph.
+	std::vector<std::vector<Point>> route( const std::vector<int> &nets, const RouteOptions &options = {} );
+	// Route every net with negotiated congestion like routeNets, without triangulating again, and store the routes
+	bool routeAll( RouteStats *stats = nullptr, const RouteOptions &options = {} );
+
+private:
+	void onGraphChange( const GraphChange &change );
+
+	Graph *graph;
+	int subscription;
+	std::unique_ptr<CDTHelper> helper;
+};
@@ -0,0 +1,191 @@
+// Throughput runner for parameter sweeps: triangulates, and optionally routes, every instance of a manifest
+// concurrently, one instance per worker at a time, and streams a CSV row per instance in completion order
+#include "algo.h"
+#include "graph.h"
+#include "layout.h"
+#include "util.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+static void usage( const char *argv0 )
+{
+	std::cerr << "Usage: " << argv0 << " [options] MANIFEST\n"
+			  << "  --jobs N         instances run concurrently (default: hardware threads)\n"
+			  << "  --threads N      CDT and routing threads inside each instance (default 1)\n"
+			  << "  --route          also route the nets of every instance\n"
+			  << "  --out FILE       write results to FILE instead of stdout\n"
+			  << "MANIFEST has one instance per line, '#' starts a comment:\n"
+			  << "  generate WIDTH HEIGHT OBSTACLES NETS SEED\n"
+			  << "  layout FILE\n";
+}
+
+// One line of the manifest: a saved layout, or the parameters of generateRandomGraph
+struct BatchInstance {
+	std::string layout;
+	double width = 0, height = 0;
+	int obsCount = 0, netCount = 0;
+	unsigned seed = 0;
+	// Manifest line, to name the instance in errors
+	size_t line = 0;
+};
+
+// Reads the manifest, false with a message on cerr at the first line it cannot parse
+static bool readManifest( std::istream &in, std::vector<BatchInstance> &instances )
+{
+	size_t line = 0;
+	for ( std::string text; std::getline( in, text ); ) {
+		++line;
+		text = text.substr( 0, text.find( '#' ) );
+		std::istringstream fields( text );
+		std::string kind;
+		if ( !( fields >> kind ) ) {
+			continue;
+		}
+		BatchInstance instance;
+		instance.line = line;
+		bool valid = false;
+		if ( kind == "generate" ) {
+			valid = static_cast<bool>( fields >> instance.width >> instance.height >> instance.obsCount >> instance.netCount >> instance.seed ) && instance.width > 0 &&
+					instance.height > 0 && instance.obsCount >= 0 && instance.netCount >= 0;
+		} else if ( kind == "layout" ) {
+			valid = static_cast<bool>( fields >> instance.layout );
+		}
+		std::string rest;
+		if ( !valid || fields >> rest ) {
+			std::cerr << "manifest line " << line << ": cannot parse \"" << text << "\"\n";
+			return false;
+		}
+		instances.push_back( std::move( instance ) );
+	}
+	return true;
+}
+
+// Everything a worker keeps between instances. Workers share nothing else but the output.
+struct BatchWorker {
+	CDTWorkspace workspace;
+	// Sum of the wall time of the instances it ran
+	double busySeconds = 0;
+	size_t instances = 0;
+};
+
+struct BatchRunner {
+	BatchRunner( const std::vector<BatchInstance> &instances, std::ostream &out ) : instances( instances ), out( out ) {}
+
+	// Run instance index on worker and write its row
+	void run( BatchWorker &worker, unsigned workerIndex, size_t index )
+	{
+		const auto &instance = instances[index];
+		Stopwatch watch;
+		std::unique_ptr<Graph> graph( instance.layout.empty() ? generateRandomGraph( instance.width, instance.height, instance.obsCount, instance.netCount, instance.seed )
+															  : loadGraph( instance.layout.c_str() ) );
+		// Saved layouts may hold geometry the triangulation cannot take, generated ones are valid by construction
+		bool valid = graph && ( instance.layout.empty() || validateGraph( *graph, 0 ).valid() );
+		double loadSeconds = watch.lap();
+		RouteStats stats;
+		bool complete = false;
+		if ( valid && route ) {
+			complete = routeNets( graph.get(), &stats, routeOptions, &worker.workspace );
+		} else if ( valid ) {
+			complete = constructCDT( graph.get(), &stats.cdt, cdtOptions, &worker.workspace );
+		}
+		double seconds = watch.lap();
+		worker.busySeconds += loadSeconds + seconds;
+		++worker.instances;
+
+		// Formatted outside the lock, which only covers the write
+		std::ostringstream row;
+		row << index << "," << instance.line << "," << workerIndex << ",";
+		if ( graph ) {
+			row << graph->getWidth() << "," << graph->getHeight() << "," << graph->getObstacles().size() << "," << graph->getNets().size() << ",";
+		} else {
+			row << instance.width << "," << instance.height << "," << instance.obsCount << "," << instance.netCount << ",";
+		}
+		row << stats.cdt.nodes << "," << stats.cdt.triangles << "," << stats.cdt.edges << "," << loadSeconds << "," << seconds << "," << stats.routed << ","
+			<< stats.unrouted << "," << stats.wirelength << "," << ( !graph ? "load_failed" : !valid ? "invalid" : complete ? "ok" : "incomplete" ) << "\n";
+		std::lock_guard<std::mutex> lock( output_mutex );
+		out << row.str() << std::flush;
+	}
+
+	const std::vector<BatchInstance> &instances;
+	std::ostream &out;
+	CDTOptions cdtOptions;
+	RouteOptions routeOptions;
+	bool route = false;
+	std::mutex output_mutex;
+};
+
+int main( int argc, char *argv[] )
+{
+	std::string manifestPath, outPath;
+	unsigned jobs = std::max( 1u, std::thread::hardware_concurrency() ), threads = 1;
+	bool route = false;
+	for ( int i = 1; i < argc; ++i ) {
+		auto hasValue = i + 1 < argc;
+		if ( !strcmp( argv[i], "--jobs" ) && hasValue ) {
+			jobs = std::max( 1ul, std::stoul( argv[++i] ) );
+		} else if ( !strcmp( argv[i], "--threads" ) && hasValue ) {
+			threads = std::max( 1ul, std::stoul( argv[++i] ) );
+		} else if ( !strcmp( argv[i], "--route" ) ) {
+			route = true;
+		} else if ( !strcmp( argv[i], "--out" ) && hasValue ) {
+			outPath = argv[++i];
+		} else if ( argv[i][0] != '-' && manifestPath.empty() ) {
+			manifestPath = argv[i];
+		} else {
+			usage( argv[0] );
+			return 1;
+		}
+	}
+	if ( manifestPath.empty() ) {
+		usage( argv[0] );
+		return 1;
+	}
+
+	std::ifstream manifest( manifestPath );
+	if ( !manifest ) {
+		std::cerr << "cannot open " << manifestPath << "\n";
+		return 1;
+	}
+	std::vector<BatchInstance> instances;
+	if ( !readManifest( manifest, instances ) ) {
+		return 1;
+	}
+	std::ofstream file;
+	if ( !outPath.empty() ) {
+		file.open( outPath );
+		if ( !file ) {
+			std::cerr << "cannot open " << outPath << "\n";
+			return 1;
+		}
+	}
+	std::ostream &out = outPath.empty() ? std::cout : file;
+	out << "index,line,worker,width,height,obs,nets,nodes,triangles,edges,load_s,run_s,routed,unrouted,wirelength,status\n" << std::flush;
+
+	BatchRunner runner( instances, out );
+	runner.cdtOptions.threads = threads;
+	runner.routeOptions.threads = threads;
+	runner.route = route;
+	jobs = std::max<size_t>( 1, std::min<size_t>( jobs, instances.size() ) );
+	std::vector<BatchWorker> workers( jobs );
+	Stopwatch watch;
+	// One instance at a time per worker, claimed in manifest order, so uneven instances still spread evenly
+	parallelForDynamic( jobs, instances.size(), 1, [&]( unsigned worker, size_t begin, size_t end ) {
+		for ( size_t index = begin; index < end; ++index ) {
+			runner.run( workers[worker], worker, index );
+		}
+	} );
+	double wall = watch.elapsed(), busy = 0;
+	for ( const auto &worker : workers ) {
+		busy += worker.busySeconds;
+	}
+	std::cerr << instances.size() << " instances on " << jobs << " workers in " << wall << "s, " << ( wall > 0 ? instances.size() / wall : 0 )
+			  << " per second, worker utilization " << ( wall > 0 ? busy / ( wall * jobs ) : 0 ) << "\n";
+	return 0;
+}
@@ -0,0 +1,332 @@
+// Headless benchmark harness for generateRandomGraph + constructCDT, and optionally routeNets
+#include "algo.h"
+#include "graph.h"
+#include "layout.h"
+#include "util.h"
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct BenchCase {
+	double width, height;
+	int obsCount, netCount;
+	unsigned seed;
+	unsigned threads;
+};
+
+struct BenchResult {
+	BenchCase config;
+	double generateSeconds;
+	CDTStats stats;
+	RouteStats route;
+	// Nodes of the largest tile and of the stitch, zero unless --tile is given
+	size_t tileNodes = 0, stitchNodes = 0;
+};
+
+static std::vector<double> parseList( const char *text )
+{
+	std::vector<double> values;
+	std::stringstream ss( text );
+	std::string item;
+	while ( std::getline( ss, item, ',' ) ) {
+		values.push_back( std::stod( item ) );
+	}
+	return values;
+}
+
+static void usage( const char *argv0 )
+{
+	std::cerr << "Usage: " << argv0 << " [options]\n"
+			  << "  --width LIST     comma separated widths (default 1000)\n"
+			  << "  --height LIST    comma separated heights (default 1000)\n"
+			  << "  --obs LIST       comma separated obstacle counts (default 10,100,1000)\n"
+			  << "  --nets LIST      comma separated net counts (default 10,100,1000)\n"
+			  << "  --seeds LIST     comma separated generator seeds (default 1)\n"
+			  << "  --threads LIST   comma separated CDT thread counts (default 1)\n"
+			  << "  --order NAME     serial CDT insertion order, bins, hilbert or brio (default hilbert, ignored by --route)\n"
+			  << "  --min-angle DEG  refine until no free triangle has a smaller angle, at most 30\n"
+			  << "  --max-area A     refine until no free triangle is larger\n"
+			  << "  --precision P    node coordinates stored as auto, double or float (default auto)\n"
+			  << "  --index BITS     node and triangle indices of auto, 32 or 64 bits (default auto)\n"
+			  << "  --route          also route the nets, with the same thread counts\n"
+			  << "  --layout FILE    triangulate a saved layout instead of generated ones, generate_s is the load time, checks included\n"
+			  << "  --validate       check the layout before triangulating it and stop at the first issue\n"
+			  << "  --repair         repair the layout before triangulating it, see repairGraph\n"
+			  << "  --tile SIZE      triangulate out of core in tiles of SIZE graph units, ignored by --route\n"
+			  << "  --tile-out FILE  layout file the tiled triangulation is written to (default tiled.layout)\n"
+			  << "  --format FMT     csv or json (default csv)\n"
+			  << "  --out FILE       write results to FILE instead of stdout\n"
+			  << "  --profile FILE   write the phase spans and counters of every run to FILE as a Chrome trace\n";
+}
+
+static double totalSeconds( const CDTStats &stats )
+{
+	double total = 0;
+	for ( const auto &phase : stats.phases ) {
+		total += phase.seconds;
+	}
+	return total;
+}
+
+static double trianglesPerSecond( const CDTStats &stats )
+{
+	double build = stats[CDTPhase::Insertion].seconds + stats[CDTPhase::Legalization].seconds;
+	return build > 0 ? stats.triangles / build : 0;
+}
+
+static void writeCsv( std::ostream &out, const std::vector<BenchResult> &results )
+{
+	out << "width,height,obs,nets,seed,threads,nodes,steiner,triangles,edges,generate_s";
+	for ( size_t i = 0; i < static_cast<size_t>( CDTPhase::Count ); ++i ) {
+		auto name = phaseName( static_cast<CDTPhase>( i ) );
+		out << "," << name << "_s," << name << "_peak_rss_kb";
+	}
+	for ( size_t i = 0; i < static_cast<size_t>( Counter::Count ); ++i ) {
+		out << "," << counterName( static_cast<Counter>( i ) );
+	}
+	out << ",cdt_total_s,triangles_per_s,route_s,routed,unrouted,route_rounds,rerouted,overflow_edges,wirelength,node_bytes,triangle_bytes,tile_nodes,stitch_nodes\n";
+	for ( const auto &[config, generateSeconds, stats, route, tileNodes, stitchNodes] : results ) {
+		out << config.width << "," << config.height << "," << config.obsCount << "," << config.netCount << "," << config.seed << "," << config.threads << ","
+			<< stats.nodes << "," << stats.steiner << "," << stats.triangles << "," << stats.edges << "," << generateSeconds;
+		for ( const auto &phase : stats.phases ) {
+			out << "," << phase.seconds << "," << phase.peakRssKb;
+		}
+		for ( auto counter : stats.profile.counters ) {
+			out << "," << counter;
+		}
+		out << "," << totalSeconds( stats ) << "," << trianglesPerSecond( stats ) << "," << route.seconds << "," << route.routed << "," << route.unrouted << ","
+			<< route.rounds << "," << route.rerouted << "," << route.overflowEdges << "," << route.wirelength << "," << stats.nodeBytes << "," << stats.triangleBytes << "," << tileNodes << ","
+			<< stitchNodes << "\n";
+	}
+}
+
+static void writeJson( std::ostream &out, const std::vector<BenchResult> &results )
+{
+	out << "[\n";
+	for ( size_t r = 0; r < results.size(); ++r ) {
+		const auto &[config, generateSeconds, stats, route, tileNodes, stitchNodes] = results[r];
+		out << "  {\"width\": " << config.width << ", \"height\": " << config.height << ", \"obs\": " << config.obsCount
+			<< ", \"nets\": " << config.netCount << ", \"seed\": " << config.seed << ", \"threads\": " << config.threads << ", \"nodes\": " << stats.nodes
+			<< ", \"steiner\": " << stats.steiner
+			<< ", \"triangles\": " << stats.triangles << ", \"edges\": " << stats.edges << ", \"generate_s\": " << generateSeconds
+			<< ", \"phases\": {";
+		for ( size_t i = 0; i < stats.phases.size(); ++i ) {
+			out << ( i ? ", " : "" ) << "\"" << phaseName( static_cast<CDTPhase>( i ) ) << "\": {\"seconds\": " << stats.phases[i].seconds
+				<< ", \"peak_rss_kb\": " << stats.phases[i].peakRssKb << "}";
+		}
+		out << "}, \"counters\": {";
+		for ( size_t i = 0; i < stats.profile.counters.size(); ++i ) {
+			out << ( i ? ", " : "" ) << "\"" << counterName( static_cast<Counter>( i ) ) << "\": " << stats.profile.counters[i];
+		}
+		out << "}, \"cdt_total_s\": " << totalSeconds( stats ) << ", \"triangles_per_s\": " << trianglesPerSecond( stats ) << ", \"route\": {\"seconds\": " << route.seconds
+			<< ", \"routed\": " << route.routed << ", \"unrouted\": " << route.unrouted << ", \"rounds\": " << route.rounds << ", \"rerouted\": " << route.rerouted
+			<< ", \"overflow_edges\": " << route.overflowEdges << ", \"wirelength\": " << route.wirelength << "}, \"node_bytes\": " << stats.nodeBytes
+			<< ", \"triangle_bytes\": " << stats.triangleBytes << ", \"tile_nodes\": " << tileNodes << ", \"stitch_nodes\": " << stitchNodes << "}"
+			<< ( r + 1 < results.size() ? "," : "" ) << "\n";
+	}
+	out << "]\n";
+}
+
+int main( int argc, char *argv[] )
+{
+	std::vector<double> widths{ 1000 }, heights{ 1000 }, obsCounts{ 10, 100, 1000 }, netCounts{ 10, 100, 1000 }, seeds{ 1 }, threadCounts{ 1 };
+	std::string format = "csv", outPath, layoutPath, profilePath, tilePath = "tiled.layout";
+	double tileSize = 0;
+	bool route = false, validate = false, repair = false;
+	CDTOptions cdtOptions;
+	for ( int i = 1; i < argc; ++i ) {
+		auto hasValue = i + 1 < argc;
+		if ( !strcmp( argv[i], "--width" ) && hasValue ) {
+			widths = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--height" ) && hasValue ) {
+			heights = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--obs" ) && hasValue ) {
+			obsCounts = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--nets" ) && hasValue ) {
+			netCounts = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--seeds" ) && hasValue ) {
+			seeds = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--threads" ) && hasValue ) {
+			threadCounts = parseList( argv[++i] );
+		} else if ( !strcmp( argv[i], "--order" ) && hasValue ) {
+			std::string order = argv[++i];
+			if ( order == "bins" ) {
+				cdtOptions.order = InsertionOrder::Bins;
+			} else if ( order == "hilbert" ) {
+				cdtOptions.order = InsertionOrder::Hilbert;
+			} else if ( order == "brio" ) {
+				cdtOptions.order = InsertionOrder::Brio;
+			} else {
+				usage( argv[0] );
+				return 1;
+			}
+		} else if ( !strcmp( argv[i], "--min-angle" ) && hasValue ) {
+			cdtOptions.refine.minAngle = std::stod( argv[++i] );
+			if ( cdtOptions.refine.minAngle > RefineOptions::maxMinAngle ) {
+				usage( argv[0] );
+				return 1;
+			}
+		} else if ( !strcmp( argv[i], "--max-area" ) && hasValue ) {
+			cdtOptions.refine.maxArea = std::stod( argv[++i] );
+		} else if ( !strcmp( argv[i], "--precision" ) && hasValue ) {
+			std::string precision = argv[++i];
+			if ( precision == "auto" ) {
+				cdtOptions.precision = CDTPrecision::Auto;
+			} else if ( precision == "double" ) {
+				cdtOptions.precision = CDTPrecision::Double;
+			} else if ( precision == "float" ) {
+				cdtOptions.precision = CDTPrecision::Float;
+			} else {
+				usage( argv[0] );
+				return 1;
+			}
+		} else if ( !strcmp( argv[i], "--index" ) && hasValue ) {
+			std::string bits = argv[++i];
+			if ( bits == "auto" ) {
+				cdtOptions.indexWidth = CDTIndexWidth::Auto;
+			} else if ( bits == "32" ) {
+				cdtOptions.indexWidth = CDTIndexWidth::Bits32;
+			} else if ( bits == "64" ) {
+				cdtOptions.indexWidth = CDTIndexWidth::Bits64;
+			} else {
+				usage( argv[0] );
+				return 1;
+			}
+		} else if ( !strcmp( argv[i], "--route" ) ) {
+			route = true;
+		} else if ( !strcmp( argv[i], "--layout" ) && hasValue ) {
+			layoutPath = argv[++i];
+		} else if ( !strcmp( argv[i], "--validate" ) ) {
+			validate = true;
+		} else if ( !strcmp( argv[i], "--repair" ) ) {
+			repair = true;
+		} else if ( !strcmp( argv[i], "--tile" ) && hasValue ) {
+			tileSize = std::stod( argv[++i] );
+		} else if ( !strcmp( argv[i], "--tile-out" ) && hasValue ) {
+			tilePath = argv[++i];
+		} else if ( !strcmp( argv[i], "--format" ) && hasValue ) {
+			format = argv[++i];
+		} else if ( !strcmp( argv[i], "--out" ) && hasValue ) {
+			outPath = argv[++i];
+		} else if ( !strcmp( argv[i], "--profile" ) && hasValue ) {
+			profilePath = argv[++i];
+		} else {
+			usage( argv[0] );
+			return 1;
+		}
+	}
+	if ( format != "csv" && format != "json" ) {
+		usage( argv[0] );
+		return 1;
+	}
+
+	std::vector<BenchResult> results;
+	bool failed = false;
+	auto run = [&]( BenchCase config, Graph *graph, double generateSeconds ) {
+		RouteStats routeStats;
+		TiledCDTStats tiled;
+		if ( route ) {
+			RouteOptions options;
+			options.threads = config.threads;
+			options.refine = cdtOptions.refine;
+			routeNets( graph, &routeStats, options );
+		} else if ( tileSize > 0 ) {
+			TiledCDTOptions options;
+			options.tileSize = tileSize;
+			options.cdt = cdtOptions;
+			options.cdt.threads = config.threads;
+			if ( !constructCDTTiled( *graph, tilePath.c_str(), &tiled, options ) ) {
+				std::cerr << "cannot write " << tilePath << "\n";
+				failed = true;
+			}
+			routeStats.cdt = tiled.cdt;
+		} else {
+			CDTOptions options = cdtOptions;
+			options.threads = config.threads;
+			constructCDT( graph, &routeStats.cdt, options );
+		}
+		results.push_back( { config, generateSeconds, routeStats.cdt, routeStats, tiled.maxTileNodes, tiled.stitchNodes } );
+		std::cerr << "done " << config.width << "x" << config.height << " obs=" << config.obsCount << " nets=" << config.netCount << " seed=" << config.seed
+				  << " threads=" << config.threads << " in " << generateSeconds + totalSeconds( routeStats.cdt ) + routeStats.seconds << "s";
+		if ( tileSize > 0 && !route ) {
+			std::cerr << ", " << tiled.tiles << " tiles of up to " << tiled.maxTileNodes << " nodes, stitch " << tiled.stitchNodes << " nodes";
+		}
+		std::cerr << "\n";
+	};
+	if ( !layoutPath.empty() ) {
+		for ( double threads : threadCounts ) {
+			Stopwatch watch;
+			std::unique_ptr<Graph> graph( loadGraph( layoutPath.c_str() ) );
+			if ( !graph ) {
+				std::cerr << "cannot load " << layoutPath << "\n";
+				return 1;
+			}
+			if ( repair ) {
+				RepairStats stats;
+				graph.reset( repairGraph( *graph, &stats ) );
+				std::cerr << "repaired " << layoutPath << ": " << stats.clampedObstacles << " obstacles clamped, " << stats.droppedObstacles << " dropped, "
+						  << stats.mergedObstacles << " merged, " << stats.clampedPins << " pins clamped, " << stats.movedPins << " moved, " << stats.droppedNets
+						  << " nets dropped\n";
+			}
+			if ( validate ) {
+				auto report = validateGraph( *graph, 1 );
+				if ( !report.valid() ) {
+					const auto &issue = report.issues.front();
+					std::cerr << layoutPath << ": " << issueName( issue.kind ) << " " << issue.item << " " << issue.other << ", repair with --repair\n";
+					return 1;
+				}
+			}
+			double loadSeconds = watch.elapsed();
+			BenchCase config{ graph->getWidth(), graph->getHeight(), static_cast<int>( graph->getObstacles().size() ), static_cast<int>( graph->getNets().size() ), 0, static_cast<unsigned>( threads ) };
+			run( config, graph.get(), loadSeconds );
+		}
+	}
+	for ( double width : layoutPath.empty() ? widths : std::vector<double>{} ) {
+		for ( double height : heights ) {
+			for ( double obsCount : obsCounts ) {
+				for ( double netCount : netCounts ) {
+					for ( double seed : seeds ) {
+						for ( double threads : threadCounts ) {
+							BenchCase config{ width, height, static_cast<int>( obsCount ), static_cast<int>( netCount ), static_cast<unsigned>( seed ), static_cast<unsigned>( threads ) };
+							Stopwatch watch;
+							std::unique_ptr<Graph> graph( generateRandomGraph( config.width, config.height, config.obsCount, config.netCount, config.seed ) );
+							run( config, graph.get(), watch.elapsed() );
+						}
+					}
+				}
+			}
+		}
+	}
+
+	std::ofstream file;
+	if ( !outPath.empty() ) {
+		file.open( outPath );
+		if ( !file ) {
+			std::cerr << "cannot open " << outPath << "\n";
+			return 1;
+		}
+	}
+	std::ostream &out = outPath.empty() ? std::cout : file;
+	format == "csv" ? writeCsv( out, results ) : writeJson( out, results );
+
+	if ( !profilePath.empty() ) {
+		std::ofstream trace( profilePath );
+		if ( !trace ) {
+			std::cerr << "cannot open " << profilePath << "\n";
+			return 1;
+		}
+		std::vector<std::tuple<std::string, const Profile *>> runs;
+		for ( const auto &result : results ) {
+			const auto &config = result.config;
+			std::ostringstream name;
+			name << config.width << "x" << config.height << " obs=" << config.obsCount << " nets=" << config.netCount << " seed=" << config.seed << " threads=" << config.threads;
+			runs.emplace_back( name.str(), &result.stats.profile );
+		}
+		writeChromeTrace( trace, runs );
+	}
+	return failed ? 1 : 0;
+}
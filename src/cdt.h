@@ -0,0 +1,1922 @@
+#pragma once
+#include "algo.h"
+#include "geometry.h"
+#include "locate.h"
+#include "mesh.h"
+#include "order.h"
+#include "predicates.h"
+#include "trace.h"
+#include "util.h"
+#include <algorithm>
+#include <cmath>
+#include <deque>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <queue>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+// CDT Algorithm
+
+template<typename Scalar, typename Index>
+struct BasicCDTGraph {
+	using Nodes = BasicNodeBuffer<Scalar>;
+
+	// storage is reused for the nodes, whatever it holds is dropped
+	explicit BasicCDTGraph( Graph *graph, Nodes storage = {} ) : nodes( std::move( storage ) ), constrained_edges()
+	{
+		nodes.clear();
+		double w = graph->getWidth(), h = graph->getHeight();
+		// Die and obstacle corners, pins, and the super triangle added later
+		nodes.reserve( 4 * ( graph->getObstacles().size() + 1 ) + 2 * graph->getNets().size() + 3 );
+		addRectangle( { 0, 0 }, { w, h } );
+		for ( auto [p1, p2] : graph->getObstacles() ) {
+			auto node_idx = addRectangle( p1, p2 );
+			holes.emplace_back( node_idx, node_idx + 3 );
+		}
+		for ( auto [p1, p2] : graph->getNets() ) {
+			pins.emplace_back( nodes.size(), nodes.size() + 1 );
+			nodes.push( std::get<0>( p1 ), std::get<1>( p1 ) );
+			nodes.push( std::get<0>( p2 ), std::get<1>( p2 ) );
+		}
+	}
+	// Adds the four corners and the four sides as constrained edges, returns the index of the first corner
+	Index addRectangle( Point p1, Point p2 )
+	{
+		auto [x1, y1] = p1;
+		auto [x2, y2] = p2;
+		auto node_idx = nodes.size();
+		nodes.push( x1, y1 );
+		nodes.push( x2, y1 );
+		nodes.push( x1, y2 );
+		nodes.push( x2, y2 );
+		constrained_edges.emplace_back( node_idx, node_idx + 1 );
+		constrained_edges.emplace_back( node_idx + 1, node_idx + 3 );
+		constrained_edges.emplace_back( node_idx + 3, node_idx + 2 );
+		constrained_edges.emplace_back( node_idx + 2, node_idx );
+		return node_idx;
+	}
+	Nodes nodes;
+	std::vector<std::tuple<Index, Index>> constrained_edges;
+	// Opposite corners (x1, y1) and (x2, y2) of every obstacle
+	std::vector<std::tuple<Index, Index>> holes;
+	// Both pins of every net
+	std::vector<std::tuple<Index, Index>> pins;
+};
+
+using CDTGraph = BasicCDTGraph<double, uint32_t>;
+
+// Everything a CDTHelper can borrow from a CDTWorkspace
+template<typename Scalar, typename Index>
+struct BasicCDTBuffers {
+	BasicTriangleMesh<Index> mesh;
+	BasicNodeBuffer<Scalar> nodes, node_scratch;
+	std::vector<Index> node_alias, triangle_stack, sort_order, sort_rank;
+	std::vector<uint64_t> sort_keys;
+	std::vector<RadixItem> radix_items, radix_scratch;
+
+	size_t capacityBytes() const
+	{
+		size_t bytes = mesh.capacityBytes() + nodes.capacityBytes() + node_scratch.capacityBytes() + sort_keys.capacity() * sizeof( uint64_t );
+		for ( auto *v : { &node_alias, &triangle_stack, &sort_order, &sort_rank } ) {
+			bytes += v->capacity() * sizeof( Index );
+		}
+		return bytes + ( radix_items.capacity() + radix_scratch.capacity() ) * sizeof( RadixItem );
+	}
+};
+
+using CDTBuffers = BasicCDTBuffers<double, uint32_t>;
+
+// Scalar stores the node coordinates, float or double; everything computed from them is double. Index numbers nodes
+// and triangles, uint32_t or uint64_t. CDTHelper is the double, 32-bit engine; constructCDT picks the others.
+template<typename Scalar, typename Index>
+struct BasicCDTHelper {
+	using Buffers = BasicCDTBuffers<Scalar, Index>;
+	using Locator = BasicPointLocator<Index>;
+
+	// With a workspace, its buffers are used for this run and handed back by the destructor
+	explicit BasicCDTHelper( Graph *graph, CDTStats *stats = nullptr, const CDTOptions &options = {}, CDTWorkspace *workspace = nullptr )
+		: graph( graph ), buffers( workspace ? borrow( *workspace ) : nullptr ), cdt_graph( graph, buffers ? std::move( buffers->nodes ) : BasicNodeBuffer<Scalar>() ),
+		  stats( stats ), options( options )
+	{
+		if ( buffers ) {
+			swapBuffers( *buffers );
+			mesh.clear();
+		}
+		mesh.reserve( 2 + 2 * cdt_graph.nodes.size() );
+	}
+	BasicCDTHelper( const BasicCDTHelper & ) = delete;
+	BasicCDTHelper &operator=( const BasicCDTHelper & ) = delete;
+	~BasicCDTHelper()
+	{
+		if ( buffers ) {
+			swapBuffers( *buffers );
+			buffers->nodes = std::move( cdt_graph.nodes );
+		}
+	}
+	static Buffers *borrow( CDTWorkspace &workspace )
+	{
+		auto &slot = std::get<std::unique_ptr<Buffers>>( workspace.buffers );
+		if ( !slot ) {
+			slot = std::make_unique<Buffers>();
+		}
+		return slot.get();
+	}
+	void swapBuffers( Buffers &buffers )
+	{
+		std::swap( mesh, buffers.mesh );
+		std::swap( node_scratch, buffers.node_scratch );
+		std::swap( node_alias, buffers.node_alias );
+		std::swap( triangle_stack, buffers.triangle_stack );
+		std::swap( sort_order, buffers.sort_order );
+		std::swap( sort_rank, buffers.sort_rank );
+		std::swap( sort_keys, buffers.sort_keys );
+		std::swap( radix_items, buffers.radix_items );
+		std::swap( radix_scratch, buffers.radix_scratch );
+	}
+
+	// Construct constrained delaunay triangulations. False if options.control cancelled it, the mesh is then
+	// unusable and the graph keeps its old CDT edges.
+	bool construct()
+	{
+		CounterScope counters;
+		bool complete = constructSteps();
+		if ( stats ) {
+			stats->profile.add( counters.counted() );
+		}
+		return complete;
+	}
+	bool constructSteps()
+	{
+		if ( !triangulate() ) {
+			return false;
+		}
+		Stopwatch watch;
+		denormalize();
+		double extraction = watch.lap();
+		if ( options.refine.enabled() ) {
+			refine();
+			recordPhase( CDTPhase::Refinement, watch.lap() );
+			if ( stopped() ) {
+				return false;
+			}
+		}
+		double extractionStart = profileNow();
+		buildLocator();
+		extractCDTEdges();
+		recordPhase( CDTPhase::Extraction, extraction + watch.lap(), false );
+		recordSpan( phaseName( CDTPhase::Extraction ), extractionStart );
+		if ( stats ) {
+			stats->nodes = cdt_graph.nodes.size() - 3;
+			stats->steiner = steiner_count;
+			stats->triangles = mesh.last();
+			stats->edges = graph->getCdtEdges().size();
+		}
+		return true;
+	}
+	// The constrained triangulation with its holes marked, still in normalized coordinates. construct() goes on from
+	// here; tiled construction reads the mesh as it is. False if options.control cancelled it or a constraint could not
+	// be recovered.
+	bool triangulate()
+	{
+		if ( options.threads > 1 ) {
+			constructDTParallel();
+		} else {
+			constructDT();
+		}
+		if ( stopped() ) {
+			return false;
+		}
+		Stopwatch watch;
+		if ( !recoverConstraints() ) {
+			return false;
+		}
+		markHoles();
+		recordPhase( CDTPhase::Constraints, watch.lap() );
+		return !stopped();
+	}
+	// Whether options.control asked the run to stop
+	bool stopped() const
+	{
+		return jobCancelled( options.control );
+	}
+	void extractCDTEdges()
+	{
+		// Edges keyed by their ends, lower index first, then sorted and made unique. An edge between two free
+		// triangles is only taken from the side where it runs upwards, so most keys are unique already.
+		unsigned shift = bitWidth( cdt_graph.nodes.size() );
+		std::vector<TwoPoints> cdt_edges;
+		auto emit = [&]( Index a, Index b ) {
+			auto [x1, y1] = cdt_graph.nodes[a];
+			auto [x2, y2] = cdt_graph.nodes[b];
+			cdt_edges.push_back( { { x1, y1 }, { x2, y2 } } );
+		};
+		if ( 2 * shift > 64 ) {
+			// Beyond 2^32 nodes a key does not fit in 64 bits, the ends are sorted as pairs instead
+			std::vector<std::tuple<Index, Index>> ends;
+			forEachFreeEdge( [&]( Index a, Index b ) { ends.emplace_back( std::min( a, b ), std::max( a, b ) ); } );
+			std::sort( ends.begin(), ends.end() );
+			ends.erase( std::unique( ends.begin(), ends.end() ), ends.end() );
+			cdt_edges.reserve( ends.size() );
+			for ( auto [a, b] : ends ) {
+				emit( a, b );
+			}
+			graph->setCdtEdges( std::move( cdt_edges ) );
+			return;
+		}
+		auto &keys = radix_items;
+		keys.clear();
+		forEachFreeEdge( [&]( Index a, Index b ) { keys.push_back( { uint64_t( std::min( a, b ) ) << shift | std::max( a, b ), 0 } ); } );
+		radixSortItems( keys, radix_scratch, 2 * shift, options.sortThreads );
+		cdt_edges.reserve( keys.size() );
+		for ( size_t k = 0; k < keys.size(); ++k ) {
+			if ( k > 0 && keys[k].key == keys[k - 1].key ) {
+				continue;
+			}
+			emit( keys[k].key >> shift, keys[k].key & ( ( uint64_t( 1 ) << shift ) - 1 ) );
+		}
+		graph->setCdtEdges( std::move( cdt_edges ) );
+	}
+	// Calls visit( a, b ) for the edges of free triangles not touching the super triangle, see extractCDTEdges
+	template<typename Visit>
+	void forEachFreeEdge( Visit visit )
+	{
+		// Every triangle slot is live, removed triangles are replaced by the last one
+		for ( Index t = 1; t <= mesh.last(); ++t ) {
+			if ( mesh.isHole( t ) ) {
+				continue;
+			}
+			for ( unsigned i = 0; i < 3; i++ ) {
+				Index a = mesh.vertex( t, i ), b = mesh.vertex( t, ( i + 1 ) % 3 ), u = mesh.adjacent( t, i );
+				if ( isSuper( a ) || isSuper( b ) || ( a > b && u != 0 && !mesh.isHole( u ) ) ) {
+					continue;
+				}
+				visit( a, b );
+			}
+		}
+	}
+
+	// Construct delaunay triangulations
+	// Algorithm framework
+	void constructDT()
+	{
+		Stopwatch watch;
+		normalize();
+		recordPhase( CDTPhase::Normalize, watch.lap() );
+		binSort();
+		recordPhase( CDTPhase::BinSort, watch.lap() );
+		if ( stopped() ) {
+			return;
+		}
+		setupSuperTriangle();
+		double insertion = watch.lap(), legalization = 0, loopStart = profileNow();
+		for ( Index i = 0; i < cdt_graph.nodes.size() - 3; ++i ) {
+			if ( i % 4096 == 0 && options.control ) {
+				if ( stopped() ) {
+					return;
+				}
+				reportProgress( options.control, phaseName( CDTPhase::Insertion ), static_cast<double>( i ) / ( cdt_graph.nodes.size() - 3 ) );
+			}
+			Index triangle = findEncloseTriangle( i );
+			if ( !insertNode( triangle, i ) ) {
+				continue;
+			}
+			if ( stats ) {
+				insertion += watch.lap();
+			}
+			testAndSwapTriangle( i );
+			if constexpr ( CDTTracer::validating ) {
+				if ( !checkTriangle() ) {
+					tracer.record( TraceEvent::ValidationFailed, i );
+					tracer.flush();
+					std::abort();
+				}
+			}
+			if ( stats ) {
+				legalization += watch.lap();
+			}
+		}
+		// Legalization runs after every insertion, one span covers both
+		recordPhase( CDTPhase::Insertion, insertion + watch.lap(), false );
+		recordPhase( CDTPhase::Legalization, legalization, false );
+		recordSpan( phaseName( CDTPhase::Insertion ), loopStart );
+	}
+	// Subroutines
+	void normalize()
+	{
+		tracer.record( TraceEvent::Normalize, cdt_graph.nodes.size() );
+		dmax = std::max( graph->getWidth(), graph->getHeight() );
+		if constexpr ( std::is_same_v<Scalar, float> ) {
+			// The smallest power of two not below it keeps the division exact, so float coordinates stay the graph
+			// coordinates
+			int exponent;
+			double mantissa = std::frexp( dmax, &exponent );
+			dmax = std::ldexp( 1.0, mantissa == 0.5 ? exponent - 1 : exponent );
+		}
+		divideCoordinates( cdt_graph.nodes.x.data(), cdt_graph.nodes.y.data(), cdt_graph.nodes.size(), dmax );
+	}
+	// Put the nodes in insertion order, see InsertionOrder. Keys are small integers, so a radix sort does it in
+	// linear time.
+	void binSort()
+	{
+		auto &nodes = cdt_graph.nodes;
+		Index count = nodes.size();
+		unsigned threads = std::max( 1u, options.sortThreads ), side;
+		auto &order = sort_order;
+		order.resize( count );
+		std::iota( order.begin(), order.end(), 0 );
+		if ( options.order == InsertionOrder::Bins ) {
+			int ndiv = side = pow( count, 0.25 );
+			binKeys( nodes.x.data(), nodes.y.data(), nodes.key.data(), count, ndiv, ndiv * 0.99 );
+			radixSort( order, nodes.key.data(), bitWidth( ndiv * ndiv ), threads, radix_items, radix_scratch );
+		} else {
+			constexpr unsigned curveBits = 16;
+			side = 1 << curveBits;
+			// BRIO puts a node in round r with probability 2^-(rounds - r), the last round is half of the nodes
+			unsigned rounds = options.order == InsertionOrder::Brio ? std::max( 1u, bitWidth( count ) ) : 1;
+			auto &keys = sort_keys;
+			keys.resize( count );
+			parallelFor( threads, count, [&]( size_t begin, size_t end ) {
+				for ( size_t i = begin; i < end; ++i ) {
+					auto cell = [&]( double v ) { return static_cast<uint32_t>( std::clamp( v * side, 0.0, side - 1.0 ) ); };
+					uint64_t round = rounds - 1 - std::min<unsigned>( __builtin_ctzll( splitMix64( i ) | 1ull << 63 ), rounds - 1 );
+					keys[i] = round << ( 2 * curveBits ) | hilbertIndex( cell( nodes.x[i] ), cell( nodes.y[i] ) );
+				}
+			} );
+			radixSort( order, keys.data(), 2 * curveBits + bitWidth( rounds - 1 ), threads, radix_items, radix_scratch );
+		}
+		reorderNodes( order );
+		tracer.record( TraceEvent::BinSort, count, side );
+	}
+	// Bits needed for values up to v
+	static unsigned bitWidth( uint64_t v )
+	{
+		return v ? 64 - __builtin_clzll( v ) : 0;
+	}
+	// Node order[i] becomes node i
+	void reorderNodes( const std::vector<Index> &order )
+	{
+		auto &rank = sort_rank;
+		rank.resize( order.size() );
+		for ( Index i = 0; i < order.size(); ++i ) {
+			rank[order[i]] = i;
+		}
+		cdt_graph.nodes.permute( order, node_scratch );
+		for ( auto &[a, b] : cdt_graph.constrained_edges ) {
+			a = rank[a], b = rank[b];
+		}
+		for ( auto &[a, b] : cdt_graph.holes ) {
+			a = rank[a], b = rank[b];
+		}
+		for ( auto &[a, b] : cdt_graph.pins ) {
+			a = rank[a], b = rank[b];
+		}
+		node_alias.resize( cdt_graph.nodes.size() );
+		std::iota( node_alias.begin(), node_alias.end(), 0 );
+	}
+	Index addSuperNodes()
+	{
+		Index node_idx = super_node = cdt_graph.nodes.size();
+		cdt_graph.nodes.push( -100, -100 );
+		cdt_graph.nodes.push( 100, -100 );
+		cdt_graph.nodes.push( 0, 100 );
+		node_alias.resize( cdt_graph.nodes.size() );
+		std::iota( node_alias.begin() + node_idx, node_alias.end(), node_idx );
+		tracer.record( TraceEvent::SuperTriangle, node_idx, node_idx + 1, node_idx + 2 );
+		return node_idx;
+	}
+	void setupSuperTriangle()
+	{
+		Index node_idx = addSuperNodes();
+		mesh.push( node_idx, node_idx + 1, node_idx + 2 );
+	}
+	// Parallel construction. The nodes are cut into vertical strips, each strip is triangulated by a radial sweep on
+	// its own thread into its own range of triangle slots, then neighbouring strips are zipped together along their
+	// common tangents and the super triangle is wrapped around the hull. Lawson flips after every step leave a
+	// Delaunay triangulation of the same nodes as the serial build, so the constraint phases do not care which one
+	// ran; only the diagonals between cocircular points may differ.
+	void constructDTParallel()
+	{
+		Stopwatch watch;
+		normalize();
+		recordPhase( CDTPhase::Normalize, watch.lap() );
+		auto strips = stripSort();
+		recordPhase( CDTPhase::BinSort, watch.lap() );
+
+		Index count = cdt_graph.nodes.size();
+		unsigned stripCount = strips.size() - 1;
+		hull_next.assign( count + 3, 0 );
+		hull_prev.assign( count + 3, 0 );
+		// A strip of m nodes never needs more than 2m triangles
+		std::vector<std::tuple<Index, Index>> ranges( stripCount );
+		std::vector<std::tuple<Index, Index>> extremes( stripCount );
+		std::vector<std::vector<Index>> deferred( stripCount );
+		Index slots = 0;
+		for ( unsigned k = 0; k < stripCount; ++k ) {
+			ranges[k] = { slots + 1, slots + 1 };
+			slots += 2 * ( strips[k + 1] - strips[k] );
+		}
+		mesh.resize( slots, count + 3 );
+		// Strips run on threads of their own, their counts and spans are handed over after the join
+		std::vector<CounterBlock> stripCounts( stripCount );
+		std::vector<ProfileSpan> stripSpans( stripCount );
+		parallelFor( options.threads, stripCount, [&]( size_t begin, size_t end ) {
+			for ( size_t k = begin; k < end; ++k ) {
+				double start = profileNow();
+				stripCounts[k] = countedBy( [&] {
+					auto &[first, next] = ranges[k];
+					auto &[leftmost, rightmost] = extremes[k];
+					next = sweepStrip( strips[k], strips[k + 1], first, leftmost, rightmost, deferred[k] );
+				} );
+				stripSpans[k] = { "sweep", static_cast<unsigned>( k + 1 ), start, profileNow() - start };
+			}
+		} );
+		for ( unsigned k = 0; k < stripCount; ++k ) {
+			countAll( stripCounts[k] );
+			if ( stats ) {
+				stats->profile.spans.push_back( stripSpans[k] );
+			}
+		}
+		mesh.compact( ranges );
+		recordPhase( CDTPhase::Insertion, watch.lap() );
+		if ( stopped() ) {
+			return;
+		}
+
+		std::vector<std::tuple<Index, Index>> edges;
+		double zipStart = profileNow();
+		for ( unsigned k = 1; k < stripCount; ++k ) {
+			zipStrips( std::get<1>( extremes[k - 1] ), std::get<0>( extremes[k] ), edges );
+		}
+		recordSpan( "zip", zipStart );
+		Index node_idx = addSuperNodes();
+		Index hullVertex = std::get<0>( extremes[0] );
+		for ( Index s = node_idx; s < node_idx + 3; ++s ) {
+			// Some hull edge always faces a super vertex, the fan over the visible chain starts there
+			while ( orient( hullVertex, hull_next[hullVertex], s ) >= 0 ) {
+				hullVertex = hull_next[hullVertex];
+			}
+			coverHull( s, hullVertex, edges, [&]( Index p0, Index p1, Index p2 ) { return mesh.push( p0, p1, p2 ); } );
+			hullVertex = s;
+		}
+		legalizeEdges( edges );
+		for ( auto &nodes : deferred ) {
+			for ( Index p : nodes ) {
+				if ( insertNode( findEncloseTriangle( p ), p ) ) {
+					testAndSwapTriangle( p );
+				}
+			}
+		}
+		if constexpr ( CDTTracer::validating ) {
+			if ( !checkTriangle() ) {
+				tracer.record( TraceEvent::ValidationFailed, count );
+				tracer.flush();
+				std::abort();
+			}
+		}
+		recordPhase( CDTPhase::Legalization, watch.lap() );
+	}
+	// Cut the nodes into at most options.threads vertical strips, reordered so that every strip is a contiguous
+	// index range sorted by x, then y. Strips are split between distinct x values and every strip spans a triangle.
+	// Returns the strip boundaries.
+	std::vector<Index> stripSort()
+	{
+		auto &nodes = cdt_graph.nodes;
+		Index count = nodes.size();
+		unsigned strips = std::max<Index>( 1, std::min<Index>( options.threads, count / minStripNodes ) );
+		// Split at x quantiles of a sorted sample
+		std::vector<double> splitters, sample;
+		for ( size_t i = 0; i < count; i += std::max<size_t>( 1, count / ( 64 * strips ) ) ) {
+			sample.push_back( nodes.x[i] );
+		}
+		std::sort( sample.begin(), sample.end() );
+		for ( unsigned k = 1; k < strips; ++k ) {
+			splitters.push_back( sample[sample.size() * k / strips] );
+		}
+		splitters.erase( std::unique( splitters.begin(), splitters.end() ), splitters.end() );
+		std::vector<Index> start( splitters.size() + 2, 0 ), order( count );
+		for ( Index i = 0; i < count; ++i ) {
+			nodes.key[i] = std::upper_bound( splitters.begin(), splitters.end(), nodes.x[i] ) - splitters.begin();
+			++start[nodes.key[i] + 1];
+		}
+		std::partial_sum( start.begin(), start.end(), start.begin() );
+		auto fill = start;
+		for ( Index i = 0; i < count; ++i ) {
+			order[fill[nodes.key[i]]++] = i;
+		}
+		parallelFor( options.threads, splitters.size() + 1, [&]( size_t begin, size_t end ) {
+			for ( size_t k = begin; k < end; ++k ) {
+				std::sort( order.begin() + start[k], order.begin() + start[k + 1], [&]( Index a, Index b ) {
+					return std::tie( nodes.x[a], nodes.y[a] ) < std::tie( nodes.x[b], nodes.y[b] );
+				} );
+			}
+		} );
+		reorderNodes( order );
+
+		// Collinear strips join the next one, or the previous one at the end
+		std::vector<Index> bounds{ 0 };
+		for ( unsigned k = 1; k + 1 < start.size(); ++k ) {
+			if ( !isCollinear( bounds.back(), start[k] ) ) {
+				bounds.push_back( start[k] );
+			}
+		}
+		if ( bounds.size() > 1 && isCollinear( bounds.back(), count ) ) {
+			bounds.pop_back();
+		}
+		bounds.push_back( count );
+		tracer.record( TraceEvent::BinSort, count, bounds.size() - 1 );
+		return bounds;
+	}
+	// Whether the nodes [begin, end) fail to span a triangle
+	bool isCollinear( Index begin, Index end )
+	{
+		Index other = begin;
+		for ( Index i = begin + 1; i < end && other == begin; ++i ) {
+			if ( cdt_graph.nodes.x[i] != cdt_graph.nodes.x[begin] || cdt_graph.nodes.y[i] != cdt_graph.nodes.y[begin] ) {
+				other = i;
+			}
+		}
+		for ( Index i = other + 1; i < end; ++i ) {
+			if ( orient( begin, other, i ) != 0 ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	// Radial sweep over the nodes [begin, end), in the spirit of Delaunator: starting from a small seed triangle,
+	// nodes are added in order of distance from its circumcentre, so each one lies outside the current convex hull
+	// and only has to be connected to the hull edges it sees. Triangles are written from slot `next` on and the
+	// slot after the last one is returned. Nodes found inside the hull, which only duplicates or rounding in the
+	// distance order can cause, are left in `deferred` for the serial insertion.
+	Index sweepStrip( Index begin, Index end, Index next, Index &leftmost, Index &rightmost, std::vector<Index> &deferred )
+	{
+		auto &nodes = cdt_graph.nodes;
+		std::vector<Index> points;
+		double minX = INFINITY, minY = INFINITY, maxX = -INFINITY, maxY = -INFINITY;
+		for ( Index i = begin; i < end; ++i ) {
+			auto [x, y] = nodes[i];
+			// Duplicates are next to each other after stripSort
+			if ( !points.empty() && x == nodes.x[points.back()] && y == nodes.y[points.back()] ) {
+				node_alias[i] = points.back();
+				continue;
+			}
+			points.push_back( i );
+			minX = std::min( minX, x ), maxX = std::max( maxX, x );
+			minY = std::min( minY, y ), maxY = std::max( maxY, y );
+		}
+		auto distance = [&]( Index p, double x, double y ) {
+			double dx = nodes.x[p] - x, dy = nodes.y[p] - y;
+			return dx * dx + dy * dy;
+		};
+		auto closest = [&]( double x, double y, Index skip ) {
+			Index best = points[0] == skip ? points[1] : points[0];
+			for ( Index p : points ) {
+				if ( p != skip && distance( p, x, y ) < distance( best, x, y ) ) {
+					best = p;
+				}
+			}
+			return best;
+		};
+		// Seed: the node closest to the centre, its nearest neighbour, and the third node giving the smallest circumcircle
+		Index i0 = closest( ( minX + maxX ) / 2, ( minY + maxY ) / 2, Locator::none );
+		Index i1 = closest( nodes.x[i0], nodes.y[i0], i0 ), i2 = Locator::none;
+		double radius = INFINITY, cx = 0, cy = 0;
+		for ( Index p : points ) {
+			if ( p == i0 || p == i1 || orient( i0, i1, p ) == 0 ) {
+				continue;
+			}
+			double x, y;
+			circumcenter( i0, i1, p, x, y );
+			if ( i2 == Locator::none || distance( p, x, y ) < radius ) {
+				i2 = p, radius = distance( p, x, y ), cx = x, cy = y;
+			}
+		}
+		if ( orient( i0, i1, i2 ) < 0 ) {
+			std::swap( i1, i2 );
+		}
+		if ( !std::isfinite( radius ) ) {
+			cx = ( nodes.x[i0] + nodes.x[i1] + nodes.x[i2] ) / 3;
+			cy = ( nodes.y[i0] + nodes.y[i1] + nodes.y[i2] ) / 3;
+		}
+		std::vector<std::tuple<double, Index>> order;
+		order.reserve( points.size() );
+		for ( Index p : points ) {
+			if ( p != i0 && p != i1 && p != i2 ) {
+				order.emplace_back( distance( p, cx, cy ), p );
+			}
+		}
+		std::sort( order.begin(), order.end() );
+
+		// Hull vertices bucketed by pseudo-angle around the centre give a nearby start for the visibility search
+		std::vector<Index> buckets( std::ceil( std::sqrt( points.size() ) ), Locator::none );
+		auto bucketOf = [&]( Index p ) {
+			double dx = nodes.x[p] - cx, dy = nodes.y[p] - cy;
+			if ( dx == 0 && dy == 0 ) {
+				return size_t( 0 );
+			}
+			double t = dx / ( std::fabs( dx ) + std::fabs( dy ) );
+			double angle = ( dy > 0 ? 3 - t : 1 + t ) / 4;
+			return static_cast<size_t>( std::floor( angle * buckets.size() ) ) % buckets.size();
+		};
+		auto push = [&]( Index p0, Index p1, Index p2 ) {
+			mesh.set( next, p0, p1, p2 );
+			return next++;
+		};
+		push( i0, i1, i2 );
+		hull_next[i0] = hull_prev[i2] = i1;
+		hull_next[i1] = hull_prev[i0] = i2;
+		hull_next[i2] = hull_prev[i1] = i0;
+		for ( Index p : { i0, i1, i2 } ) {
+			buckets[bucketOf( p )] = p;
+		}
+		Index onHull = i0;
+		std::vector<std::tuple<Index, Index>> edges;
+		for ( auto [_, p] : order ) {
+			Index start = Locator::none, key = bucketOf( p );
+			for ( size_t j = 0; j < buckets.size(); ++j ) {
+				start = buckets[( key + j ) % buckets.size()];
+				// Vertices dropped from the hull point at themselves
+				if ( start != Locator::none && hull_next[start] != start ) {
+					break;
+				}
+			}
+			start = hull_prev[start];
+			Index e = start;
+			while ( orient( e, hull_next[e], p ) >= 0 ) {
+				e = hull_next[e];
+				countEvent( Counter::HullSteps );
+				if ( e == start ) {
+					break;
+				}
+			}
+			if ( orient( e, hull_next[e], p ) >= 0 ) {
+				deferred.push_back( p );
+				continue;
+			}
+			Index first = coverHull( p, e, edges, push );
+			legalizeEdges( edges );
+			buckets[bucketOf( p )] = p;
+			buckets[bucketOf( first )] = first;
+			onHull = p;
+		}
+
+		leftmost = rightmost = onHull;
+		Index v = onHull;
+		do {
+			auto [x, y] = nodes[v];
+			if ( std::tie( x, y ) < std::tie( nodes.x[leftmost], nodes.y[leftmost] ) ) {
+				leftmost = v;
+			}
+			if ( std::tie( x, y ) > std::tie( nodes.x[rightmost], nodes.y[rightmost] ) ) {
+				rightmost = v;
+			}
+			v = hull_next[v];
+		} while ( v != onHull );
+		return next;
+	}
+	// Connect p, outside the convex hull, to the chain of hull edges it sees, which contains the edge starting at e.
+	// New triangles come from push( p0, p1, p2 ) and their edges are queued for legalizeEdges(). Returns the first
+	// vertex of the chain, which stays on the hull together with the last one.
+	template<typename Push>
+	Index coverHull( Index p, Index e, std::vector<std::tuple<Index, Index>> &edges, Push push )
+	{
+		Index first = e, stop = hull_next[e];
+		while ( orient( hull_prev[first], first, p ) < 0 ) {
+			first = hull_prev[first];
+			countEvent( Counter::HullSteps );
+		}
+		while ( orient( stop, hull_next[stop], p ) < 0 ) {
+			stop = hull_next[stop];
+			countEvent( Counter::HullSteps );
+		}
+		// Look up the triangles behind the chain before the new ones change the vertex-to-triangle map
+		std::vector<std::tuple<Index, Index>> behind;
+		for ( Index a = first; a != stop; a = hull_next[a] ) {
+			Index t;
+			unsigned i;
+			[[maybe_unused]] bool found = findEdge( a, hull_next[a], t, i );
+			assert( found );
+			behind.emplace_back( t, i );
+		}
+		Index a = first, previous = 0;
+		for ( auto [t, i] : behind ) {
+			Index b = hull_next[a];
+			// (b, a, p): edge 0 is the old hull edge, edge 1 is shared with the previous fan triangle
+			Index nt = push( b, a, p );
+			mesh.link( nt, 0, t, i );
+			if ( previous != 0 ) {
+				mesh.link( nt, 1, previous, 2 );
+			}
+			edges.emplace_back( nt, 0 );
+			edges.emplace_back( nt, 1 );
+			if ( a != first ) {
+				hull_next[a] = a;
+			}
+			previous = nt, a = b;
+		}
+		hull_next[first] = hull_prev[stop] = p;
+		hull_prev[p] = first, hull_next[p] = stop;
+		return first;
+	}
+	// Merge two triangulated strips, the left one ending with its rightmost hull vertex and the right one starting
+	// with its leftmost. The gap between the lower and upper common tangents is filled like the merge step of
+	// Guibas and Stolfi, and the new edges are queued for legalizeEdges().
+	void zipStrips( Index leftRight, Index rightLeft, std::vector<std::tuple<Index, Index>> &edges )
+	{
+		// Tangents end at the innermost of several collinear hull vertices
+		Index lb = leftRight, rb = rightLeft, lt = leftRight, rt = rightLeft;
+		for ( bool moved = true; moved; ) {
+			moved = false;
+			for ( ; orient( lb, rb, hull_prev[lb] ) < 0; moved = true ) {
+				lb = hull_prev[lb];
+				countEvent( Counter::ZipSteps );
+			}
+			for ( ; orient( lb, rb, hull_next[rb] ) < 0; moved = true ) {
+				rb = hull_next[rb];
+				countEvent( Counter::ZipSteps );
+			}
+		}
+		for ( bool moved = true; moved; ) {
+			moved = false;
+			for ( ; orient( lt, rt, hull_next[lt] ) > 0; moved = true ) {
+				lt = hull_next[lt];
+				countEvent( Counter::ZipSteps );
+			}
+			for ( ; orient( lt, rt, hull_prev[rt] ) > 0; moved = true ) {
+				rt = hull_prev[rt];
+				countEvent( Counter::ZipSteps );
+			}
+		}
+		// The hull chains facing the gap, bottom to top, with the triangles behind them
+		std::vector<std::tuple<Index, Index>> leftChain, rightChain;
+		for ( Index a = lb; a != lt; a = hull_next[a] ) {
+			Index t;
+			unsigned i;
+			[[maybe_unused]] bool found = findEdge( a, hull_next[a], t, i );
+			assert( found );
+			leftChain.emplace_back( t, i );
+		}
+		for ( Index a = rb; a != rt; a = hull_prev[a] ) {
+			Index t;
+			unsigned i;
+			[[maybe_unused]] bool found = findEdge( hull_prev[a], a, t, i );
+			assert( found );
+			rightChain.emplace_back( t, i );
+		}
+		Index l = lb, r = rb, li = 0, ri = 0, previous = 0;
+		unsigned previousEdge = 0;
+		while ( l != lt || r != rt ) {
+			Index lc = hull_next[l], rc = hull_prev[r];
+			bool right = l == lt;
+			if ( l != lt && r != rt ) {
+				// A candidate is valid when it lies above the base and the other chain does not reach into the
+				// corner of the new triangle. When both are valid, prefer the Delaunay one.
+				bool rightValid = orient( l, r, rc ) > 0 && !insideCorner( l, r, rc, lc );
+				bool leftValid = orient( l, r, lc ) > 0 && !insideCorner( r, lc, l, rc );
+				assert( rightValid || leftValid );
+				right = rightValid && ( !leftValid || !inCircle( l, r, rc, lc ) );
+			}
+			Index t;
+			if ( right ) {
+				// (l, r, rc): edge 1 is the right hull edge, edge 2 the next base
+				t = mesh.push( l, r, rc );
+				auto [u, j] = rightChain[ri++];
+				mesh.link( t, 1, u, j );
+				mesh.link( t, 0, previous, previousEdge );
+				previousEdge = 2, r = rc;
+			} else {
+				// (l, r, lc): edge 2 is the left hull edge, edge 1 the next base
+				t = mesh.push( l, r, lc );
+				auto [u, j] = leftChain[li++];
+				mesh.link( t, 2, u, j );
+				mesh.link( t, 0, previous, previousEdge );
+				previousEdge = 1, l = lc;
+			}
+			previous = t;
+			for ( unsigned i = 0; i < 3; i++ ) {
+				edges.emplace_back( t, i );
+			}
+		}
+		hull_next[lb] = rb, hull_prev[rb] = lb;
+		hull_next[rt] = lt, hull_prev[lt] = rt;
+	}
+	// Whether p lies in the corner at apex of a counter-clockwise triangle, between apex-a and apex-b.
+	// Points on apex-b count when they are closer than b.
+	bool insideCorner( Index apex, Index a, Index b, Index p )
+	{
+		double o = orient( apex, b, p );
+		return orient( apex, a, p ) > 0 && ( o < 0 || ( o == 0 && inFront( b, apex, p ) ) );
+	}
+	// Lawson flips until every queued edge, and every edge next to a flip, is locally Delaunay
+	void legalizeEdges( std::vector<std::tuple<Index, Index>> &edges )
+	{
+		while ( !edges.empty() ) {
+			auto [t, i] = edges.back();
+			edges.pop_back();
+			Index u = mesh.adjacent( t, i );
+			unsigned j = mesh.adjacentEdge( t, i );
+			if ( u == 0 || mesh.isConstrained( t, i ) || !inCircumcircle( t, mesh.vertex( u, ( j + 2 ) % 3 ) ) ) {
+				continue;
+			}
+			flipEdge( t, i );
+			// See flipEdge for the edges that changed neighbours
+			edges.emplace_back( t, i );
+			edges.emplace_back( t, ( i + 2 ) % 3 );
+			edges.emplace_back( u, j );
+			edges.emplace_back( u, ( j + 2 ) % 3 );
+		}
+	}
+	// During the initial build, nodes come in binSort order so the newest triangle is the best place to start
+	Index findEncloseTriangle( Index p )
+	{
+		auto [x, y] = cdt_graph.nodes[p];
+		Index steps = 0, triangle = walk( mesh.last(), x, y, steps, false );
+		countEvent( Counter::Locates );
+		countEvent( Counter::WalkSteps, steps );
+		tracer.record( TraceEvent::Locate, p, triangle, steps, x, y );
+		return triangle;
+	}
+	// Triangle containing (x, y), for arbitrary query points after construct(). Points on an edge
+	// may return either side, points inside obstacles return a hole triangle, points outside the super
+	// triangle return 0.
+	Index locate( double x, double y )
+	{
+		auto vertex = locator.hint( x, y );
+		Index steps = 0, start = vertex == Locator::none ? mesh.last() : mesh.vertexTriangle( vertex );
+		Index triangle = walk( start, x, y, steps, true );
+		countEvent( Counter::Locates );
+		countEvent( Counter::WalkSteps, steps );
+		return triangle;
+	}
+	// Visibility walk. The plain walk always terminates on a Delaunay triangulation; once constraints are
+	// in place it may cycle, so the stochastic variant picks the edge tested first at random.
+	// 0 when (x, y) lies outside the mesh, past its boundary.
+	Index walk( Index triangle, double x, double y, Index &steps, bool stochastic )
+	{
+		for ( ;; ++steps ) {
+			unsigned first = 0;
+			bool crossed = false;
+			Index next = 0;
+			if ( stochastic ) {
+				walk_seed ^= walk_seed << 13, walk_seed ^= walk_seed >> 17, walk_seed ^= walk_seed << 5;
+				first = walk_seed % 3;
+			}
+			for ( unsigned k = 0; k < 3; k++ ) {
+				unsigned i = ( first + k ) % 3;
+				auto [x1, y1] = cdt_graph.nodes[mesh.vertex( triangle, i )];
+				auto [x2, y2] = cdt_graph.nodes[mesh.vertex( triangle, ( i + 1 ) % 3 )];
+				if ( orient2d( x1, y1, x2, y2, x, y ) < 0 ) {
+					next = mesh.adjacent( triangle, i );
+					crossed = true;
+					break;
+				}
+			}
+			if ( !crossed ) {
+				return triangle;
+			}
+			if ( next == 0 ) {
+				return 0;
+			}
+			triangle = next;
+		}
+	}
+	void buildLocator()
+	{
+		Index count = cdt_graph.nodes.size() - 3;
+		locator.reset( 0, 0, graph->getWidth(), graph->getHeight(), count );
+		for ( Index i = 0; i < cdt_graph.nodes.size(); ++i ) {
+			if ( node_alias[i] == i && !isSuper( i ) ) {
+				auto [x, y] = cdt_graph.nodes[i];
+				locator.add( i, x, y );
+			}
+		}
+	}
+	// Insert node into the triangle returned by findEncloseTriangle.
+	// Nodes on an edge split both triangles sharing it, nodes coinciding with a vertex are skipped.
+	bool insertNode( Index triangle, Index node )
+	{
+		auto [x, y] = cdt_graph.nodes[node];
+		for ( unsigned i = 0; i < 3; i++ ) {
+			auto [x1, y1] = cdt_graph.nodes[mesh.vertex( triangle, i )];
+			if ( x == x1 && y == y1 ) {
+				node_alias[node] = mesh.vertex( triangle, i );
+				return false;
+			}
+		}
+		for ( unsigned i = 0; i < 3; i++ ) {
+			if ( orientation( triangle, i, ( i + 1 ) % 3, node ) == 0 ) {
+				splitEdge( triangle, i, node );
+				return true;
+			}
+		}
+		splitTriangle( triangle, node );
+		return true;
+	}
+	void splitTriangle( Index triangle, Index node )
+	{
+		auto [p0, p1, p2] = triangleVertices( triangle );
+		auto adj0 = mesh.adjacent( triangle, 0 ), adj2 = mesh.adjacent( triangle, 2 );
+		auto edge0 = mesh.adjacentEdge( triangle, 0 ), edge2 = mesh.adjacentEdge( triangle, 2 );
+		auto fixed0 = mesh.isConstrained( triangle, 0 ), fixed2 = mesh.isConstrained( triangle, 2 );
+		auto nt1 = mesh.push( p0, p1, node ), nt2 = mesh.push( p0, node, p2 );
+		mesh.setHole( nt1, mesh.isHole( triangle ) );
+		mesh.setHole( nt2, mesh.isHole( triangle ) );
+		mesh.vertex( triangle, 0 ) = node;
+		mesh.link( nt1, 0, adj0, edge0, fixed0 );
+		mesh.link( nt1, 1, triangle, 0 );
+		mesh.link( nt1, 2, nt2, 0 );
+		mesh.link( nt2, 1, triangle, 2 );
+		mesh.link( nt2, 2, adj2, edge2, fixed2 );
+		triangle_stack.push_back( triangle );
+		triangle_stack.push_back( nt1 );
+		triangle_stack.push_back( nt2 );
+		countEvent( Counter::TriangleSplits );
+		tracer.record( TraceEvent::Split, triangle, node, nt1 );
+	}
+	void splitEdge( Index triangle, unsigned edge, Index node )
+	{
+		// triangle (a, b, c) and its neighbour (b, a, d) across edge a-b become
+		// (node, b, c), (a, node, c), (b, node, d) and (node, a, d)
+		unsigned i2 = ( edge + 2 ) % 3;
+		auto a = mesh.vertex( triangle, edge ), c = mesh.vertex( triangle, i2 );
+		Index other = mesh.adjacent( triangle, edge );
+		unsigned otherEdge = mesh.adjacentEdge( triangle, edge );
+		Index adjCA = mesh.adjacent( triangle, i2 );
+		unsigned adjCAEdge = mesh.adjacentEdge( triangle, i2 );
+		auto fixedAB = mesh.isConstrained( triangle, edge ), fixedCA = mesh.isConstrained( triangle, i2 );
+		mesh.vertex( triangle, edge ) = node;
+		auto nt1 = mesh.push( a, node, c );
+		mesh.setHole( nt1, mesh.isHole( triangle ) );
+		mesh.link( nt1, 1, triangle, i2 );
+		mesh.link( nt1, 2, adjCA, adjCAEdge, fixedCA );
+		triangle_stack.push_back( triangle );
+		triangle_stack.push_back( nt1 );
+		if ( other != 0 ) {
+			unsigned j1 = ( otherEdge + 1 ) % 3, j2 = ( otherEdge + 2 ) % 3;
+			auto d = mesh.vertex( other, j2 );
+			Index adjAD = mesh.adjacent( other, j1 );
+			unsigned adjADEdge = mesh.adjacentEdge( other, j1 );
+			auto fixedAD = mesh.isConstrained( other, j1 );
+			mesh.vertex( other, j1 ) = node;
+			auto nt2 = mesh.push( node, a, d );
+			mesh.setHole( nt2, mesh.isHole( other ) );
+			mesh.link( nt2, 0, nt1, 0, fixedAB );
+			mesh.link( nt2, 1, adjAD, adjADEdge, fixedAD );
+			mesh.link( nt2, 2, other, j1 );
+			mesh.link( triangle, edge, other, otherEdge, fixedAB );
+			triangle_stack.push_back( other );
+			triangle_stack.push_back( nt2 );
+		} else {
+			mesh.link( nt1, 0, 0, 0, fixedAB );
+			mesh.link( triangle, edge, 0, 0, fixedAB );
+		}
+		countEvent( Counter::EdgeSplits );
+		tracer.record( TraceEvent::Split, triangle, node, nt1 );
+	}
+	void testAndSwapTriangle( Index p )
+	{
+		while ( !triangle_stack.empty() ) {
+			auto tl = triangle_stack.back();
+			triangle_stack.pop_back();
+
+			// The edge of tl opposite to p
+			unsigned edge = ( mesh.indexOf( tl, p ) + 1 ) % 3;
+			Index tr = mesh.adjacent( tl, edge );
+			if ( tr == 0 || mesh.isConstrained( tl, edge ) ) {
+				continue;
+			}
+			// Flip when the far vertex of tr is strictly inside the circumcircle of tl
+			if ( !inCircumcircle( tl, mesh.vertex( tr, ( mesh.adjacentEdge( tl, edge ) + 2 ) % 3 ) ) ) {
+				continue;
+			}
+			flipEdge( tl, edge );
+
+			triangle_stack.push_back( tl );
+			triangle_stack.push_back( tr );
+			tracer.record( TraceEvent::Flip, tl, tr, p );
+		}
+	}
+	// Flip edge i of triangle t, shared with u = adj[i]. With t = (a, b, p) and u = (b, a, q) counted from edge i,
+	// t becomes (a, q, p) and u becomes (b, p, q), keeping their slot positions; the new diagonal is p-q.
+	void flipEdge( Index t, unsigned i )
+	{
+		unsigned i1 = ( i + 1 ) % 3, i2 = ( i + 2 ) % 3;
+		Index u = mesh.adjacent( t, i );
+		unsigned j = mesh.adjacentEdge( t, i );
+		unsigned j1 = ( j + 1 ) % 3, j2 = ( j + 2 ) % 3;
+		auto p = mesh.vertex( t, i2 ), q = mesh.vertex( u, j2 );
+		Index ta = mesh.adjacent( u, j1 );
+		unsigned taEdge = mesh.adjacentEdge( u, j1 );
+		auto tc = mesh.adjacent( t, i1 ), tcEdge = mesh.adjacentEdge( t, i1 );
+		auto fixedA = mesh.isConstrained( u, j1 ), fixedC = mesh.isConstrained( t, i1 );
+		mesh.vertex( t, i1 ) = q;
+		mesh.vertex( u, j1 ) = p;
+		mesh.link( t, i, ta, taEdge, fixedA );
+		mesh.link( t, i1, u, j1 );
+		mesh.link( u, j, tc, tcEdge, fixedC );
+		mesh.touch( t );
+		mesh.touch( u );
+		countEvent( Counter::Flips );
+	}
+
+	// Constrained edge recovery, following Sloan, "A fast algorithm for generating constrained
+	// Delaunay triangulations": the edges crossing a constraint are flipped away one by one,
+	// then the new edges are made Delaunay again without touching the constraint.
+	// False, leaving the mesh a valid but incomplete CDT, at the first constraint that cannot be recovered.
+	bool recoverConstraints()
+	{
+		for ( auto [a, b] : cdt_graph.constrained_edges ) {
+			if ( !insertConstraint( node_alias[a], node_alias[b] ) ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	// False if an edge it flips or the recovered edge is missing from the mesh, which only an inconsistent mesh
+	// allows; the recovery stops there rather than flipping unrelated triangles
+	bool insertConstraint( Index a, Index b )
+	{
+		std::deque<std::tuple<Index, Index>> crossing;
+		std::vector<std::tuple<Index, Index>> created;
+		while ( a != b ) {
+			// Vertices lying exactly on a-b split it, so c is either b or the first of them
+			Index c = traceSegment( a, b, crossing );
+			created.clear();
+			while ( !crossing.empty() ) {
+				auto [x, y] = crossing.front();
+				crossing.pop_front();
+				Index t;
+				unsigned i;
+				if ( !findEdge( x, y, t, i ) ) {
+					return false;
+				}
+				Index u = mesh.adjacent( t, i );
+				auto p = mesh.vertex( t, ( i + 2 ) % 3 ), q = mesh.vertex( u, ( mesh.adjacentEdge( t, i ) + 2 ) % 3 );
+				if ( !oppositeSides( orient( p, q, x ), orient( p, q, y ) ) ) {
+					// Quadrilateral is not strictly convex, try again once its neighbours have been flipped
+					crossing.emplace_back( x, y );
+					continue;
+				}
+				flipEdge( t, i );
+				countEvent( Counter::ConstraintFlips );
+				tracer.record( TraceEvent::Flip, t, u, c );
+				if ( p != a && p != c && q != a && q != c && oppositeSides( orient( a, c, p ), orient( a, c, q ) ) ) {
+					crossing.emplace_back( p, q );
+				} else {
+					created.emplace_back( p, q );
+				}
+			}
+			Index t;
+			unsigned i;
+			if ( !findEdge( a, c, t, i ) ) {
+				return false;
+			}
+			mesh.setConstrained( t, i, true );
+			restoreDelaunay( created );
+			a = c;
+		}
+		return true;
+	}
+	// Collect the edges crossed by segment a-b, walking from a. Returns b, or the first vertex hit on the segment.
+	Index traceSegment( Index a, Index b, std::deque<std::tuple<Index, Index>> &crossing )
+	{
+		// Rotate around a to the triangle whose wedge at a contains the direction to b
+		Index t = mesh.vertexTriangle( a );
+		unsigned k = mesh.indexOf( t, a );
+		for ( ;; ) {
+			auto v1 = mesh.vertex( t, ( k + 1 ) % 3 ), v2 = mesh.vertex( t, ( k + 2 ) % 3 );
+			double o1 = orient( a, v1, b ), o2 = orient( a, v2, b );
+			if ( o1 == 0 && inFront( a, b, v1 ) ) {
+				return v1;
+			}
+			if ( o2 == 0 && inFront( a, b, v2 ) ) {
+				return v2;
+			}
+			if ( o1 > 0 && o2 < 0 ) {
+				break;
+			}
+			// Counter-clockwise neighbour around a
+			Index next = mesh.adjacent( t, ( k + 2 ) % 3 );
+			assert( next != 0 );
+			t = next, k = mesh.indexOf( t, a );
+		}
+		// Walk through the triangles crossed by a-b, right and left are the endpoints of the entry edge
+		unsigned edge = ( k + 1 ) % 3;
+		for ( ;; ) {
+			auto right = mesh.vertex( t, edge ), left = mesh.vertex( t, ( edge + 1 ) % 3 );
+			crossing.emplace_back( right, left );
+			Index u = mesh.adjacent( t, edge );
+			unsigned e = mesh.adjacentEdge( t, edge );
+			auto w = mesh.vertex( u, ( e + 2 ) % 3 );
+			double o = orient( a, b, w );
+			if ( w == b || o == 0 ) {
+				return w;
+			}
+			// u is (left, right, w) from edge e, leave through right-w when w is left of a-b, else through w-left
+			t = u, edge = o > 0 ? ( e + 1 ) % 3 : ( e + 2 ) % 3;
+		}
+	}
+	// Lawson flips on the edges created while recovering a constraint
+	void restoreDelaunay( std::vector<std::tuple<Index, Index>> &created )
+	{
+		for ( bool swapped = true; swapped; ) {
+			swapped = false;
+			for ( auto &[x, y] : created ) {
+				Index t;
+				unsigned i;
+				if ( !findEdge( x, y, t, i ) || mesh.isConstrained( t, i ) ) {
+					continue;
+				}
+				Index u = mesh.adjacent( t, i );
+				if ( u == 0 ) {
+					continue;
+				}
+				auto p = mesh.vertex( t, ( i + 2 ) % 3 ), q = mesh.vertex( u, ( mesh.adjacentEdge( t, i ) + 2 ) % 3 );
+				if ( inCircumcircle( t, q ) ) {
+					flipEdge( t, i );
+					x = p, y = q;
+					swapped = true;
+				}
+			}
+		}
+	}
+	// Flood fill obstacle interiors without crossing constrained edges
+	void markHoles()
+	{
+		for ( auto [c0, c3] : cdt_graph.holes ) {
+			fillRegion( holeSeed( node_alias[c0], node_alias[c3] ), true );
+		}
+	}
+	// The triangle at lower left corner a of an obstacle that contains the direction of the diagonal to b
+	Index holeSeed( Index a, Index b )
+	{
+		Index t = mesh.vertexTriangle( a );
+		unsigned k = mesh.indexOf( t, a );
+		while ( !( orient( a, mesh.vertex( t, ( k + 1 ) % 3 ), b ) >= 0 && orient( a, mesh.vertex( t, ( k + 2 ) % 3 ), b ) < 0 ) ) {
+			t = mesh.adjacent( t, ( k + 2 ) % 3 ), k = mesh.indexOf( t, a );
+		}
+		return t;
+	}
+	// Set the hole flag of the region around t, bounded by constrained edges. Triangles already flagged that way
+	// stop the fill, so repainting after a local edit only visits the triangles it changed.
+	void fillRegion( Index t, bool hole )
+	{
+		std::vector<Index> todo{ t };
+		while ( !todo.empty() ) {
+			t = todo.back();
+			todo.pop_back();
+			if ( mesh.isHole( t ) == hole ) {
+				continue;
+			}
+			mesh.setHole( t, hole );
+			for ( unsigned i = 0; i < 3; i++ ) {
+				if ( !mesh.isConstrained( t, i ) && mesh.adjacent( t, i ) != 0 ) {
+					todo.push_back( mesh.adjacent( t, i ) );
+				}
+			}
+		}
+	}
+	void denormalize()
+	{
+		multiplyCoordinates( cdt_graph.nodes.x.data(), cdt_graph.nodes.y.data(), cdt_graph.nodes.size(), dmax );
+	}
+
+	// Delaunay refinement after Ruppert, in graph coordinates. Encroached segments, constrained edges with a vertex
+	// of a free triangle inside their diametral circle, are split at their midpoints first. Then the free triangle
+	// with the worst circumradius to shortest edge ratio among those missing a target gets a Steiner point at its
+	// circumcenter, unless that point lies beyond a segment or encroaches one, which is split instead. Each insertion
+	// only looks at the star of the new vertex, so the work stays close to linear in the points added.
+	void refine()
+	{
+		const RefineOptions &target = options.refine;
+		// Bound on the squared ratio, from circumradius / shortest edge = 1 / ( 2 sin( minAngle ) )
+		double minAngle = std::min( target.minAngle, RefineOptions::maxMinAngle );
+		double sine = std::sin( minAngle * std::acos( -1.0 ) / 180 );
+		double ratioBound = minAngle > 0 ? 1 / ( 4 * sine * sine ) : 0;
+		// Nothing shorter is split, which stops refinement at features below the precision of the coordinates
+		double minEdge = 1e-9 * dmax;
+		// Worst ratio first, with the vertices of the triangle to tell a slot that has changed since
+		std::priority_queue<std::tuple<double, Index, Index, Index, Index>> bad;
+		std::vector<std::tuple<Index, Index>> segments;
+		auto inspect = [&]( Index t ) {
+			auto [a, b, c] = triangleVertices( t );
+			if ( mesh.isHole( t ) || isSuper( a ) || isSuper( b ) || isSuper( c ) ) {
+				return;
+			}
+			for ( unsigned i = 0; i < 3; i++ ) {
+				if ( mesh.isConstrained( t, i ) && encroaches( mesh.vertex( t, i ), mesh.vertex( t, ( i + 1 ) % 3 ), cdt_graph.nodes[mesh.vertex( t, ( i + 2 ) % 3 )] ) ) {
+					segments.emplace_back( mesh.vertex( t, i ), mesh.vertex( t, ( i + 1 ) % 3 ) );
+				}
+			}
+			double ab = squaredDistance( a, b ), bc = squaredDistance( b, c ), ca = squaredDistance( c, a );
+			double shortest = std::min( { ab, bc, ca } ), longest = std::max( { ab, bc, ca } ), area = orient( a, b, c ) / 2;
+			if ( shortest < minEdge * minEdge || area <= 0 ) {
+				return;
+			}
+			double ratio = ab * bc * ca / ( 16 * area * area * shortest );
+			bool skinny = ratioBound > 0 && ratio > ratioBound, large = target.maxArea > 0 && area > target.maxArea;
+			if ( !skinny && !large && target.sizeField ) {
+				auto [xa, ya] = cdt_graph.nodes[a];
+				auto [xb, yb] = cdt_graph.nodes[b];
+				auto [xc, yc] = cdt_graph.nodes[c];
+				double size = target.sizeField( ( xa + xb + xc ) / 3, ( ya + yb + yc ) / 3 );
+				large = size > 0 && longest > size * size;
+			}
+			if ( skinny || large ) {
+				bad.emplace( ratio, t, a, b, c );
+			}
+		};
+		auto inspectStar = [&]( Index v ) {
+			for ( auto [t, k] : star( v ) ) {
+				inspect( t );
+			}
+		};
+		// Split segment a-b if it still exists, false if it does not or is too short
+		auto splitSegment = [&]( Index a, Index b ) {
+			Index t;
+			unsigned i;
+			if ( !findEdge( a, b, t, i ) || !mesh.isConstrained( t, i ) || squaredDistance( a, b ) < 4 * minEdge * minEdge ) {
+				return false;
+			}
+			auto [xa, ya] = cdt_graph.nodes[a];
+			auto [xb, yb] = cdt_graph.nodes[b];
+			Index node = addSteinerNode( ( xa + xb ) / 2, ( ya + yb ) / 2 );
+			splitEdge( t, i, node );
+			testAndSwapTriangle( node );
+			inspectStar( node );
+			return true;
+		};
+
+		for ( Index t = 1; t <= mesh.last(); ++t ) {
+			inspect( t );
+		}
+		std::vector<std::tuple<Index, Index>> encroached;
+		// A Steiner point adds at most two triangles, which must stay below the largest Index
+		size_t limit = std::min<size_t>( target.maxSteiner, ( std::numeric_limits<Index>::max() - mesh.last() ) / 2 - 1 );
+		for ( size_t added = 0; added < limit; ) {
+			if ( added % 4096 == 0 && stopped() ) {
+				return;
+			}
+			if ( !segments.empty() ) {
+				auto [a, b] = segments.back();
+				segments.pop_back();
+				added += splitSegment( a, b );
+				continue;
+			}
+			if ( bad.empty() ) {
+				break;
+			}
+			auto [ratio, t, a, b, c] = bad.top();
+			bad.pop();
+			if ( triangleVertices( t ) != std::make_tuple( a, b, c ) ) {
+				continue;
+			}
+			double x, y;
+			circumcenter( a, b, c, x, y );
+			Index blockT;
+			unsigned blockI;
+			Index into = walkToward( t, x, y, blockT, blockI );
+			encroached.clear();
+			if ( into == 0 ) {
+				if ( blockT == 0 ) {
+					continue;
+				}
+				encroached.emplace_back( mesh.vertex( blockT, blockI ), mesh.vertex( blockT, ( blockI + 1 ) % 3 ) );
+			} else {
+				encroachedByPoint( into, x, y, encroached );
+			}
+			if ( !encroached.empty() ) {
+				bool split = false;
+				for ( auto [p, q] : encroached ) {
+					if ( splitSegment( p, q ) ) {
+						split = true;
+						++added;
+					}
+				}
+				// Try again once the segments are split, or give up on a triangle next to segments too short to split
+				if ( split ) {
+					bad.emplace( ratio, t, a, b, c );
+				}
+				continue;
+			}
+			Index node = addSteinerNode( x, y );
+			if ( insertNode( into, node ) ) {
+				testAndSwapTriangle( node );
+				inspectStar( node );
+			}
+			++added;
+		}
+	}
+	Index addSteinerNode( double x, double y )
+	{
+		Index node = cdt_graph.nodes.size();
+		cdt_graph.nodes.push( x, y );
+		node_alias.push_back( node );
+		++steiner_count;
+		return node;
+	}
+	// Triangle containing (x, y), reached from triangle t along the straight line from its centroid. Returns 0 if a
+	// constrained edge is in the way, given in blockT and blockI, or if the walk fails on a degenerate case, with
+	// blockT = 0.
+	Index walkToward( Index t, double x, double y, Index &blockT, unsigned &blockI )
+	{
+		auto [a, b, c] = triangleVertices( t );
+		double sx = ( cdt_graph.nodes.x[a] + cdt_graph.nodes.x[b] + cdt_graph.nodes.x[c] ) / 3;
+		double sy = ( cdt_graph.nodes.y[a] + cdt_graph.nodes.y[b] + cdt_graph.nodes.y[c] ) / 3;
+		blockT = 0;
+		for ( Index steps = 0; steps <= mesh.last(); ++steps ) {
+			unsigned exit = 3, inside = 0;
+			for ( unsigned i = 0; i < 3 && exit == 3; i++ ) {
+				auto [x1, y1] = cdt_graph.nodes[mesh.vertex( t, i )];
+				auto [x2, y2] = cdt_graph.nodes[mesh.vertex( t, ( i + 1 ) % 3 )];
+				if ( orient2d( x1, y1, x2, y2, x, y ) >= 0 ) {
+					++inside;
+				} else if ( orient2d( sx, sy, x, y, x1, y1 ) <= 0 && orient2d( sx, sy, x, y, x2, y2 ) >= 0 ) {
+					exit = i;
+				}
+			}
+			if ( inside == 3 ) {
+				return t;
+			}
+			if ( exit == 3 ) {
+				return 0;
+			}
+			if ( mesh.isConstrained( t, exit ) || mesh.adjacent( t, exit ) == 0 ) {
+				blockT = t, blockI = exit;
+				return 0;
+			}
+			t = mesh.adjacent( t, exit );
+		}
+		return 0;
+	}
+	// Constrained edges around the cavity a vertex at (x, y) inside triangle t would open, the triangles whose
+	// circumcircle holds it, that have (x, y) inside their diametral circle
+	void encroachedByPoint( Index t, double x, double y, std::vector<std::tuple<Index, Index>> &found )
+	{
+		std::vector<Index> cavity{ t };
+		for ( size_t k = 0; k < cavity.size(); ++k ) {
+			t = cavity[k];
+			for ( unsigned i = 0; i < 3; i++ ) {
+				Index a = mesh.vertex( t, i ), b = mesh.vertex( t, ( i + 1 ) % 3 ), u = mesh.adjacent( t, i );
+				if ( mesh.isConstrained( t, i ) ) {
+					if ( encroaches( a, b, { x, y } ) ) {
+						found.emplace_back( a, b );
+					}
+					continue;
+				}
+				if ( u == 0 || std::find( cavity.begin(), cavity.end(), u ) != cavity.end() ) {
+					continue;
+				}
+				auto [x1, y1] = cdt_graph.nodes[mesh.vertex( u, 0 )];
+				auto [x2, y2] = cdt_graph.nodes[mesh.vertex( u, 1 )];
+				auto [x3, y3] = cdt_graph.nodes[mesh.vertex( u, 2 )];
+				if ( incircle( x1, y1, x2, y2, x3, y3, x, y ) > 0 ) {
+					cavity.push_back( u );
+				}
+			}
+		}
+	}
+	// Whether p lies strictly inside the circle with diameter a-b
+	bool encroaches( Index a, Index b, Vec2 p )
+	{
+		auto [xa, ya] = cdt_graph.nodes[a];
+		auto [xb, yb] = cdt_graph.nodes[b];
+		return ( p.x - xa ) * ( p.x - xb ) + ( p.y - ya ) * ( p.y - yb ) < 0;
+	}
+	double squaredDistance( Index a, Index b )
+	{
+		auto [xa, ya] = cdt_graph.nodes[a];
+		auto [xb, yb] = cdt_graph.nodes[b];
+		return ( xa - xb ) * ( xa - xb ) + ( ya - yb ) * ( ya - yb );
+	}
+
+	// Dynamic updates after construct(), in graph coordinates. Obstacles and nets keep their indices in the Graph,
+	// removing one moves the last one into its place. Nodes of removed points are recycled by later additions, so
+	// the node arrays stay as large as the most points alive at once.
+	void addNet( Point p1, Point p2 )
+	{
+		Index a = addPoint( p1 ), b = addPoint( p2 );
+		cdt_graph.pins.emplace_back( a, b );
+	}
+	void removeNet( int index )
+	{
+		auto [a, b] = cdt_graph.pins[index];
+		removePoint( a );
+		removePoint( b );
+		cdt_graph.pins[index] = cdt_graph.pins.back();
+		cdt_graph.pins.pop_back();
+	}
+	void addObstacle( Point p1, Point p2 )
+	{
+		trackConstraints();
+		// Corners in the order of CDTGraph::addRectangle, in recycled nodes when there are any
+		auto [x1, y1] = p1;
+		auto [x2, y2] = p2;
+		Index c0 = newNode( x1, y1 ), c1 = newNode( x2, y1 ), c2 = newNode( x1, y2 ), c3 = newNode( x2, y2 );
+		auto &sides = cdt_graph.constrained_edges;
+		sides.emplace_back( c0, c1 );
+		sides.emplace_back( c1, c3 );
+		sides.emplace_back( c3, c2 );
+		sides.emplace_back( c2, c0 );
+		cdt_graph.holes.emplace_back( c0, c3 );
+		for ( Index node : { c0, c1, c2, c3 } ) {
+			addVertex( node );
+		}
+		for ( auto it = sides.end() - 4; it != sides.end(); ++it ) {
+			Index a = node_alias[std::get<0>( *it )], b = node_alias[std::get<1>( *it )];
+			// A side that could not be recovered is left unconstrained rather than counted
+			if ( !insertConstraint( a, b ) ) {
+				continue;
+			}
+			for ( auto [x, y] : constraintPieces( a, b ) ) {
+				++constraint_uses[edgeKey( x, y )];
+			}
+		}
+		fillRegion( holeSeed( node_alias[c0], node_alias[c3] ), true );
+		validate( c0 );
+	}
+	void removeObstacle( int index )
+	{
+		trackConstraints();
+		auto [c0, c3] = cdt_graph.holes[index];
+		fillRegion( holeSeed( node_alias[c0], node_alias[c3] ), false );
+		// Sides shared with another obstacle stay constrained, the others may flip again
+		Index side = 4 + 4 * index;
+		std::vector<std::tuple<Index, Index>> edges;
+		for ( Index k = side; k < side + 4; ++k ) {
+			auto [a, b] = cdt_graph.constrained_edges[k];
+			for ( auto [x, y] : constraintPieces( node_alias[a], node_alias[b] ) ) {
+				// A side addObstacle could not recover has no count and no mesh edge to release
+				auto it = constraint_uses.find( edgeKey( x, y ) );
+				if ( it == constraint_uses.end() || --it->second > 0 ) {
+					continue;
+				}
+				constraint_uses.erase( it );
+				Index t;
+				unsigned i;
+				if ( findEdge( x, y, t, i ) ) {
+					mesh.setConstrained( t, i, false );
+					edges.emplace_back( t, i );
+				}
+			}
+		}
+		legalizeEdges( edges );
+		for ( Index k = side; k < side + 4; ++k ) {
+			removePoint( std::get<0>( cdt_graph.constrained_edges[k] ) );
+		}
+		auto &sides = cdt_graph.constrained_edges;
+		std::copy( sides.end() - 4, sides.end(), sides.begin() + side );
+		sides.resize( sides.size() - 4 );
+		cdt_graph.holes[index] = cdt_graph.holes.back();
+		cdt_graph.holes.pop_back();
+		validate( c0 );
+	}
+	void moveObstacle( int index, Point p1, Point p2 )
+	{
+		removeObstacle( index );
+		addObstacle( p1, p2 );
+		// The new obstacle goes back to index, the one that filled the gap returns to the end
+		Index last = cdt_graph.holes.size() - 1;
+		std::swap( cdt_graph.holes[index], cdt_graph.holes[last] );
+		auto &sides = cdt_graph.constrained_edges;
+		std::swap_ranges( sides.begin() + 4 + 4 * index, sides.begin() + 8 + 4 * index, sides.begin() + 4 + 4 * last );
+	}
+	Index addPoint( Point p )
+	{
+		trackConstraints();
+		Index node = newNode( std::get<0>( p ), std::get<1>( p ) );
+		addVertex( node );
+		validate( node );
+		return node;
+	}
+	// A node at (x, y) for addVertex, taken from the recycled ones first
+	Index newNode( double x, double y )
+	{
+		if ( free_nodes.empty() ) {
+			cdt_graph.nodes.push( x, y );
+			node_alias.push_back( Locator::none );
+			vertex_uses.push_back( 0 );
+			return cdt_graph.nodes.size() - 1;
+		}
+		Index node = free_nodes.back();
+		free_nodes.pop_back();
+		cdt_graph.nodes.x[node] = x;
+		cdt_graph.nodes.y[node] = y;
+		cdt_graph.nodes.key[node] = 0;
+		return node;
+	}
+	// A node can be recycled once no point is at it and it is not the vertex of another point
+	void recycle( Index node )
+	{
+		if ( node_alias[node] == Locator::none && vertex_uses[node] == 0 ) {
+			free_nodes.push_back( node );
+		}
+	}
+	void removePoint( Index node )
+	{
+		trackConstraints();
+		Index v = node_alias[node];
+		node_alias[node] = Locator::none;
+		if ( --vertex_uses[v] == 0 ) {
+			removeVertex( v );
+		}
+		recycle( node );
+		if ( v != node ) {
+			recycle( v );
+		}
+		validate( node );
+	}
+	// Insert the last appended node and legalize its cavity, or alias it to a vertex at the same position
+	void addVertex( Index node )
+	{
+		auto [x, y] = cdt_graph.nodes[node];
+		node_alias[node] = node;
+		// Graph points lie in the die, which the super triangle covers
+		Index triangle = locate( x, y );
+		assert( triangle != 0 );
+		if ( insertNode( triangle, node ) ) {
+			// A node on a constrained edge splits it into two halves along the same obstacle sides
+			auto fixed = constrainedNeighbors( node );
+			if ( fixed.size() == 2 ) {
+				auto it = constraint_uses.find( edgeKey( fixed[0], fixed[1] ) );
+				Index uses = it->second;
+				constraint_uses.erase( it );
+				constraint_uses[edgeKey( fixed[0], node )] = uses;
+				constraint_uses[edgeKey( node, fixed[1] )] = uses;
+			}
+			testAndSwapTriangle( node );
+			locator.add( node, x, y );
+		}
+		++vertex_uses[node_alias[node]];
+	}
+	// Take vertex v out of the mesh and re-triangulate its star. A vertex inside a constrained edge, like a pin on an
+	// obstacle side, splits the star into two polygons that keep their hole flags and the constraint between them.
+	void removeVertex( Index v )
+	{
+		auto around = star( v );
+		std::vector<size_t> cuts;
+		for ( size_t i = 0; i < around.size(); ++i ) {
+			auto [t, k] = around[i];
+			if ( mesh.isConstrained( t, k ) ) {
+				cuts.push_back( i );
+			}
+		}
+		assert( cuts.empty() || cuts.size() == 2 );
+		bool split = !cuts.empty();
+		if ( !split ) {
+			cuts.push_back( 0 );
+		}
+		std::vector<std::tuple<Index, Index>> edges, closing;
+		std::vector<Index> freed, ends;
+		for ( size_t r = 0; r < cuts.size(); ++r ) {
+			size_t begin = cuts[r], end = r + 1 < cuts.size() ? cuts[r + 1] : cuts[0] + around.size();
+			// The far edges of the star triangles form the polygon, counter-clockwise
+			std::vector<Index> polygon, slots;
+			std::vector<std::tuple<Index, Index, bool>> outer;
+			for ( size_t i = begin; i < end; ++i ) {
+				auto [t, k] = around[i % around.size()];
+				unsigned e = ( k + 1 ) % 3;
+				polygon.push_back( mesh.vertex( t, e ) );
+				outer.emplace_back( mesh.adjacent( t, e ), mesh.adjacentEdge( t, e ), mesh.isConstrained( t, e ) );
+				slots.push_back( t );
+			}
+			if ( split ) {
+				auto [t, k] = around[( end - 1 ) % around.size()];
+				polygon.push_back( mesh.vertex( t, ( k + 2 ) % 3 ) );
+				outer.emplace_back( Locator::none, 0, true );
+				ends.push_back( polygon.front() );
+			}
+			size_t used = polygon.size() - 2;
+			closing.push_back( fillPolygon( polygon, outer, slots, mesh.isHole( slots[0] ), edges ) );
+			freed.insert( freed.end(), slots.begin() + used, slots.end() );
+		}
+		if ( split ) {
+			// Both polygons close along the constraint that ran through v
+			Index a = ends[0], b = ends[1];
+			assert( orient( a, b, v ) == 0 );
+			auto [t, i] = closing[0];
+			auto [u, j] = closing[1];
+			mesh.link( t, i, u, j, true );
+			Index uses = constraint_uses[edgeKey( a, v )];
+			constraint_uses.erase( edgeKey( a, v ) );
+			constraint_uses.erase( edgeKey( b, v ) );
+			constraint_uses[edgeKey( a, b )] = uses;
+		}
+		legalizeEdges( edges );
+		// Removing from the back keeps the remaining freed slots in place
+		std::sort( freed.begin(), freed.end(), std::greater<>() );
+		for ( Index t : freed ) {
+			mesh.remove( t );
+		}
+		auto [x, y] = cdt_graph.nodes[v];
+		locator.remove( v, x, y );
+	}
+	// Triangulate a counter-clockwise polygon into the given slots by ear clipping, preferring ears whose circumcircle
+	// holds no other polygon vertex; legalizeEdges() on the queued edges finishes the job. outer[i] is the neighbour
+	// across polygon[i]-polygon[i + 1], a neighbour of none is left open and returned.
+	std::tuple<Index, Index> fillPolygon( std::vector<Index> polygon, std::vector<std::tuple<Index, Index, bool>> outer, const std::vector<Index> &slots, bool hole, std::vector<std::tuple<Index, Index>> &edges )
+	{
+		std::tuple<Index, Index> open{ 0, 0 };
+		size_t used = 0;
+		auto emit = [&]( Index a, Index b, Index c, std::initializer_list<std::tuple<Index, Index, bool>> sides ) {
+			Index t = slots[used++];
+			unsigned i = 0;
+			mesh.set( t, a, b, c );
+			mesh.setHole( t, hole );
+			for ( auto [u, j, fixed] : sides ) {
+				if ( u == Locator::none ) {
+					open = { t, i };
+				} else {
+					mesh.link( t, i, u, j, fixed );
+				}
+				++i;
+			}
+			for ( i = 0; i < 3; i++ ) {
+				edges.emplace_back( t, i );
+			}
+			return t;
+		};
+		while ( polygon.size() > 3 ) {
+			size_t n = polygon.size(), ear = n;
+			for ( size_t i = 0; i < n; ++i ) {
+				Index a = polygon[( i + n - 1 ) % n], b = polygon[i], c = polygon[( i + 1 ) % n];
+				if ( orient( a, b, c ) <= 0 ) {
+					continue;
+				}
+				bool empty = true, delaunay = true;
+				for ( Index p : polygon ) {
+					if ( p == a || p == b || p == c ) {
+						continue;
+					}
+					empty = empty && !( orient( a, b, p ) >= 0 && orient( b, c, p ) >= 0 && orient( c, a, p ) >= 0 );
+					delaunay = delaunay && !inCircle( a, b, c, p );
+				}
+				if ( empty && ear == n ) {
+					ear = i;
+				}
+				if ( empty && delaunay ) {
+					ear = i;
+					break;
+				}
+			}
+			assert( ear != n );
+			size_t previous = ( ear + n - 1 ) % n;
+			// (a, b, c): edges 0 and 1 are on the polygon, edge 2 is the diagonal that replaces them
+			Index t = emit( polygon[previous], polygon[ear], polygon[( ear + 1 ) % n], { outer[previous], outer[ear] } );
+			outer[previous] = { t, 2, false };
+			polygon.erase( polygon.begin() + ear );
+			outer.erase( outer.begin() + ear );
+		}
+		emit( polygon[0], polygon[1], polygon[2], { outer[0], outer[1], outer[2] } );
+		return open;
+	}
+	// Triangles around vertex v in counter-clockwise order, with the index of v in each. Only the super
+	// triangle vertices lie on the outer boundary, so the rotation around any other vertex closes.
+	std::vector<std::tuple<Index, Index>> star( Index v )
+	{
+		std::vector<std::tuple<Index, Index>> around;
+		Index start = mesh.vertexTriangle( v ), t = start;
+		do {
+			unsigned k = mesh.indexOf( t, v );
+			around.emplace_back( t, k );
+			t = mesh.adjacent( t, ( k + 2 ) % 3 );
+		} while ( t != start );
+		return around;
+	}
+	// Far ends of the constrained edges at v
+	std::vector<Index> constrainedNeighbors( Index v )
+	{
+		std::vector<Index> neighbors;
+		for ( auto [t, k] : star( v ) ) {
+			if ( mesh.isConstrained( t, k ) ) {
+				neighbors.push_back( mesh.vertex( t, ( k + 1 ) % 3 ) );
+			}
+		}
+		return neighbors;
+	}
+	// Mesh edges making up the recovered constraint a-b, split at the vertices lying on it
+	std::vector<std::tuple<Index, Index>> constraintPieces( Index a, Index b )
+	{
+		std::vector<std::tuple<Index, Index>> pieces;
+		std::deque<std::tuple<Index, Index>> crossing;
+		while ( a != b ) {
+			Index c = traceSegment( a, b, crossing );
+			assert( crossing.empty() );
+			pieces.emplace_back( a, c );
+			a = c;
+		}
+		return pieces;
+	}
+	static uint64_t edgeKey( Index a, Index b )
+	{
+		return a < b ? uint64_t( a ) << 32 | b : uint64_t( b ) << 32 | a;
+	}
+	// Count the live nodes of every vertex and the obstacle sides along every constrained edge, so edits can tell
+	// when a vertex or a constraint is no longer needed. Runs once, on the first edit.
+	void trackConstraints()
+	{
+		if ( tracking ) {
+			return;
+		}
+		tracking = true;
+		vertex_uses.assign( node_alias.size(), 0 );
+		for ( Index i = 0; i < node_alias.size(); ++i ) {
+			if ( !isSuper( i ) && node_alias[i] != Locator::none ) {
+				++vertex_uses[node_alias[i]];
+			}
+		}
+		for ( Index i = 0; i < node_alias.size(); ++i ) {
+			if ( !isSuper( i ) ) {
+				recycle( i );
+			}
+		}
+		for ( auto [a, b] : cdt_graph.constrained_edges ) {
+			for ( auto [x, y] : constraintPieces( node_alias[a], node_alias[b] ) ) {
+				++constraint_uses[edgeKey( x, y )];
+			}
+		}
+	}
+	void validate( Index node )
+	{
+		if constexpr ( CDTTracer::validating ) {
+			if ( !checkTriangle() ) {
+				tracer.record( TraceEvent::ValidationFailed, node );
+				tracer.flush();
+				std::abort();
+			}
+		}
+	}
+
+	// Help functions
+	// Add seconds to phase, and a span of that length ending now to the profile unless the phase was interleaved
+	// with another one
+	void recordPhase( CDTPhase phase, double seconds, bool span = true )
+	{
+		if ( stats ) {
+			( *stats )[phase].seconds += seconds;
+			( *stats )[phase].peakRssKb = peakRssKb();
+			if ( span ) {
+				recordSpan( phaseName( phase ), profileNow() - seconds );
+			}
+		}
+		reportProgress( options.control, phaseName( phase ), 1 );
+	}
+	// Profile span of the calling thread from start, a profileNow() value, to now
+	void recordSpan( const char *name, double start )
+	{
+		if ( stats ) {
+			stats->profile.spans.push_back( { name, 0, start, profileNow() - start } );
+		}
+	}
+	double profileNow() const
+	{
+		return stats ? stats->profile.now() : 0;
+	}
+	bool isSuper( Index p ) const
+	{
+		return p >= super_node && p < super_node + 3;
+	}
+	double orient( Index p1, Index p2, Index p )
+	{
+		auto [x1, y1] = cdt_graph.nodes[p1];
+		auto [x2, y2] = cdt_graph.nodes[p2];
+		auto [x, y] = cdt_graph.nodes[p];
+		return orient2d( x1, y1, x2, y2, x, y );
+	}
+	static bool oppositeSides( double o1, double o2 )
+	{
+		return ( o1 > 0 && o2 < 0 ) || ( o1 < 0 && o2 > 0 );
+	}
+	// Whether p, known to be on the line a-b, lies on the ray from a towards b
+	bool inFront( Index a, Index b, Index p )
+	{
+		auto [xa, ya] = cdt_graph.nodes[a];
+		auto [xb, yb] = cdt_graph.nodes[b];
+		auto [x, y] = cdt_graph.nodes[p];
+		return ( xb - xa ) * ( x - xa ) + ( yb - ya ) * ( y - ya ) > 0;
+	}
+	// Find the triangle t having x-y as edge i, in either direction
+	bool findEdge( Index x, Index y, Index &t, unsigned &i )
+	{
+		// Rotate counter-clockwise around x, then clockwise if the rotation ran into the outer boundary
+		Index start = mesh.vertexTriangle( x );
+		for ( unsigned direction : { 2, 0 } ) {
+			t = start;
+			do {
+				unsigned k = mesh.indexOf( t, x );
+				if ( mesh.vertex( t, ( k + 1 ) % 3 ) == y ) {
+					i = k;
+					return true;
+				}
+				if ( mesh.vertex( t, ( k + 2 ) % 3 ) == y ) {
+					i = ( k + 2 ) % 3;
+					return true;
+				}
+				t = mesh.adjacent( t, ( k + direction ) % 3 );
+			} while ( t != start && t != 0 );
+			if ( t == start ) {
+				break;
+			}
+		}
+		return false;
+	}
+	double orientation( Index triangle, Index t1, Index t2, Index p )
+	{
+		auto [x1, y1] = cdt_graph.nodes[mesh.vertex( triangle, t1 )];
+		auto [x2, y2] = cdt_graph.nodes[mesh.vertex( triangle, t2 )];
+		auto [x, y] = cdt_graph.nodes[p];
+		return orient2d( x1, y1, x2, y2, x, y );
+	}
+	bool inCircumcircle( Index triangle, Index p )
+	{
+		return inCircle( mesh.vertex( triangle, 0 ), mesh.vertex( triangle, 1 ), mesh.vertex( triangle, 2 ), p );
+	}
+	// Whether p is strictly inside the circle through the counter-clockwise a, b, c
+	bool inCircle( Index a, Index b, Index c, Index p )
+	{
+		auto [x1, y1] = cdt_graph.nodes[a];
+		auto [x2, y2] = cdt_graph.nodes[b];
+		auto [x3, y3] = cdt_graph.nodes[c];
+		auto [x, y] = cdt_graph.nodes[p];
+		return incircle( x1, y1, x2, y2, x3, y3, x, y ) > 0;
+	}
+	void circumcenter( Index a, Index b, Index c, double &x, double &y )
+	{
+		auto [ax, ay] = cdt_graph.nodes[a];
+		auto [bx, by] = cdt_graph.nodes[b];
+		auto [cx, cy] = cdt_graph.nodes[c];
+		double dx = bx - ax, dy = by - ay, ex = cx - ax, ey = cy - ay;
+		double bl = dx * dx + dy * dy, cl = ex * ex + ey * ey, d = 0.5 / ( dx * ey - dy * ex );
+		x = ax + ( ey * bl - dy * cl ) * d;
+		y = ay + ( dx * cl - ex * bl ) * d;
+	}
+	std::tuple<Index, Index, Index> triangleVertices( Index t )
+	{
+		auto &r = mesh[t];
+		return { r.v[0], r.v[1], r.v[2] };
+	}
+	bool checkTriangle()
+	{
+		std::vector<bool> vis( mesh.last() + 1, false );
+		std::queue<Index> q;
+		q.push( 1 );
+		while ( !q.empty() ) {
+			auto t = q.front();
+			q.pop();
+			if ( vis[t] ) {
+				continue;
+			}
+			vis[t] = true;
+			for ( unsigned i = 0; i < 3; i++ ) {
+				auto t2 = mesh.adjacent( t, i );
+				if ( t2 == 0 ) {
+					continue;
+				}
+				auto j = mesh.adjacentEdge( t, i );
+				if ( mesh.adjacent( t2, j ) != t || mesh.adjacentEdge( t2, j ) != i ) {
+					return false;
+				}
+				if ( mesh.vertex( t, i ) != mesh.vertex( t2, ( j + 1 ) % 3 ) || mesh.vertex( t, ( i + 1 ) % 3 ) != mesh.vertex( t2, j ) ) {
+					return false;
+				}
+				q.push( t2 );
+			}
+		}
+		return true;
+	}
+
+	Graph *graph;
+	Buffers *buffers;
+	BasicCDTGraph<Scalar, Index> cdt_graph;
+	BasicTriangleMesh<Index> mesh;
+	std::vector<Index> triangle_stack;
+	// Duplicated nodes are not inserted, they map to the vertex at the same position
+	std::vector<Index> node_alias;
+	Locator locator;
+	uint32_t walk_seed = 2463534242u;
+	double dmax = 0;
+	CDTStats *stats;
+	CDTOptions options;
+	// Convex hull as a circular list during the parallel build
+	std::vector<Index> hull_next, hull_prev;
+	// Nodes added after construct() come after the three super triangle vertices
+	Index super_node = 0;
+	size_t steiner_count = 0;
+	// Reference counts for the dynamic updates, built by the first one: live nodes per vertex, and obstacle sides
+	// running along each constrained edge, keyed by edgeKey()
+	bool tracking = false;
+	std::vector<Index> vertex_uses;
+	std::unordered_map<uint64_t, Index> constraint_uses;
+	// Nodes no point uses any more, reused by newNode
+	std::vector<Index> free_nodes;
+	// Scratch space of the node sorts and of extractCDTEdges
+	BasicNodeBuffer<Scalar> node_scratch;
+	std::vector<Index> sort_order, sort_rank;
+	std::vector<uint64_t> sort_keys;
+	std::vector<RadixItem> radix_items, radix_scratch;
+	static constexpr unsigned minStripNodes = 4096;
+	using CDTTracer = Tracer<traceLevel>;
+	CDTTracer tracer;
+};
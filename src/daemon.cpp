@@ -0,0 +1,405 @@
+// Resident layout server: loads or generates a graph once, keeps its triangulation live with DynamicCDT and answers
+// batched queries over a Unix-domain socket, see protocol.h
+#include "algo.h"
+#include "graph.h"
+#include "layout.h"
+#include "protocol.h"
+#include "util.h"
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <memory>
+#include <poll.h>
+#include <sstream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <vector>
+
+static void usage( const char *argv0 )
+{
+	std::cerr << "Usage: " << argv0 << " [options]\n"
+			  << "  --socket PATH    socket to listen on (default aarf.sock)\n"
+			  << "  --layout FILE    serve a saved layout\n"
+			  << "  --generate LIST  serve a generated graph: width,height,obs,nets (default 1000,1000,100,100)\n"
+			  << "  --seed N         generator seed (default 1)\n"
+			  << "  --threads N      threads for the triangulation and for RouteAll (default 1)\n"
+			  << "  --repair         repair a layout validateGraph rejects instead of refusing to serve it\n";
+}
+
+struct Daemon {
+	Daemon( Graph *graph, const CDTOptions &cdtOptions, const RouteOptions &routeOptions )
+		: graph( graph ), cdt( graph, nullptr, cdtOptions ), routeOptions( routeOptions )
+	{
+		subscription = graph->subscribe( [this]( const GraphChange & ) { ++version; } );
+	}
+	~Daemon()
+	{
+		graph->unsubscribe( subscription );
+	}
+	Daemon( const Daemon & ) = delete;
+	Daemon &operator=( const Daemon & ) = delete;
+
+	// Run the commands of a request frame and append their results to reply
+	void handle( FrameReader &in, FrameWriter &reply )
+	{
+		while ( !in.done() ) {
+			uint8_t op;
+			in.get( op );
+			size_t statusAt = reply.bytes.size();
+			// A full reply has no room left for even a status, the batch ends as if malformed
+			if ( statusAt >= maxFrameBytes ) {
+				break;
+			}
+			reply.put( DaemonStatus::Ok );
+			DaemonStatus status = run( static_cast<DaemonOp>( op ), in, reply );
+			if ( status == DaemonStatus::Ok && reply.bytes.size() > maxFrameBytes ) {
+				status = DaemonStatus::TooLarge;
+			}
+			if ( status != DaemonStatus::Ok ) {
+				// Drop whatever the command had written
+				reply.bytes.resize( statusAt );
+				reply.put( status );
+			}
+			if ( status == DaemonStatus::Malformed ) {
+				break;
+			}
+		}
+	}
+	DaemonStatus run( DaemonOp op, FrameReader &in, FrameWriter &out )
+	{
+		switch ( op ) {
+			case DaemonOp::Info:
+				out.put( graph->getWidth() );
+				out.put( graph->getHeight() );
+				out.put( static_cast<uint32_t>( graph->getObstacles().size() ) );
+				out.put( static_cast<uint32_t>( graph->getNets().size() ) );
+				return DaemonStatus::Ok;
+			case DaemonOp::AddNet: {
+				double x1, y1, x2, y2;
+				if ( !in.get( x1 ) || !in.get( y1 ) || !in.get( x2 ) || !in.get( y2 ) ) {
+					return DaemonStatus::Malformed;
+				}
+				if ( !inside( x1, y1 ) || !inside( x2, y2 ) ) {
+					return DaemonStatus::Invalid;
+				}
+				out.put( static_cast<uint32_t>( graph->addNet( { { x1, y1 }, { x2, y2 } } ) ) );
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::RemoveNet: {
+				uint32_t net;
+				if ( !in.get( net ) ) {
+					return DaemonStatus::Malformed;
+				}
+				if ( net >= graph->getNets().size() ) {
+					return DaemonStatus::Invalid;
+				}
+				graph->removeNet( net );
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::Locate: {
+				double x, y;
+				if ( !in.get( x ) || !in.get( y ) ) {
+					return DaemonStatus::Malformed;
+				}
+				if ( !inside( x, y ) ) {
+					return DaemonStatus::Invalid;
+				}
+				auto face = cdt.locate( x, y );
+				out.put( static_cast<uint8_t>( face.free ) );
+				for ( auto [cx, cy] : face.corners ) {
+					out.put( cx );
+					out.put( cy );
+				}
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::Route: {
+				uint32_t count;
+				// Checked before allocating, the count comes from the client
+				if ( !in.get( count ) || count > in.remaining() / sizeof( uint32_t ) ) {
+					return DaemonStatus::Malformed;
+				}
+				std::vector<int> nets( count );
+				bool known = true;
+				for ( auto &net : nets ) {
+					uint32_t id;
+					if ( !in.get( id ) ) {
+						return DaemonStatus::Malformed;
+					}
+					net = id;
+					known = known && id < graph->getNets().size();
+				}
+				if ( !known ) {
+					return DaemonStatus::Invalid;
+				}
+				for ( const auto &route : cdt.route( nets, routeOptions ) ) {
+					out.put( static_cast<uint32_t>( route.size() ) );
+					for ( auto [x, y] : route ) {
+						out.put( x );
+						out.put( y );
+					}
+				}
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::RouteAll: {
+				RouteStats stats;
+				cdt.routeAll( &stats, routeOptions );
+				out.put( static_cast<uint32_t>( stats.routed ) );
+				out.put( static_cast<uint32_t>( stats.unrouted ) );
+				out.put( static_cast<uint32_t>( stats.overflowEdges ) );
+				out.put( stats.wirelength );
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::Edges: {
+				uint64_t first;
+				uint32_t max;
+				if ( !in.get( first ) || !in.get( max ) ) {
+					return DaemonStatus::Malformed;
+				}
+				// Only edits change the CDT, so pages of one version are extracted once
+				if ( published != version ) {
+					cdt.publish();
+					published = version;
+				}
+				auto &edges = graph->getCdtEdges();
+				if ( first > edges.size() ) {
+					return DaemonStatus::Invalid;
+				}
+				// As many as the frame has room for after the header of this result
+				constexpr size_t edgeBytes = 4 * sizeof( double );
+				size_t used = out.bytes.size() + 2 * sizeof( uint64_t ) + sizeof( uint32_t );
+				size_t room = used < maxFrameBytes ? ( maxFrameBytes - used ) / edgeBytes : 0;
+				size_t count = std::min<size_t>( { max, edges.size() - first, room } );
+				out.put( version );
+				out.put( static_cast<uint64_t>( edges.size() ) );
+				out.put( static_cast<uint32_t>( count ) );
+				for ( size_t e = first; e < first + count; ++e ) {
+					auto [p1, p2] = edges[e];
+					out.put( std::get<0>( p1 ) );
+					out.put( std::get<1>( p1 ) );
+					out.put( std::get<0>( p2 ) );
+					out.put( std::get<1>( p2 ) );
+				}
+				return DaemonStatus::Ok;
+			}
+			case DaemonOp::Shutdown:
+				shutdown = true;
+				return DaemonStatus::Ok;
+			default:
+				return DaemonStatus::Malformed;
+		}
+	}
+	bool inside( double x, double y ) const
+	{
+		return x >= 0 && x <= graph->getWidth() && y >= 0 && y <= graph->getHeight();
+	}
+
+	Graph *graph;
+	DynamicCDT cdt;
+	RouteOptions routeOptions;
+	int subscription;
+	// Bumped by every edit of the graph; the CDT edges in the graph are those of version published
+	uint64_t version = 0, published = ~uint64_t( 0 );
+	bool shutdown = false;
+};
+
+// A connection, the bytes it sent that do not make a whole frame yet and the reply it has not taken yet
+struct Client {
+	int fd;
+	std::vector<char> input, output;
+	// Bytes of input already answered and of output already written
+	size_t consumed = 0, sent = 0;
+};
+
+// Read what the client sent. False on end of stream or error.
+static bool receive( Client &client )
+{
+	client.input.erase( client.input.begin(), client.input.begin() + client.consumed );
+	client.consumed = 0;
+	char chunk[65536];
+	for ( ;; ) {
+		ssize_t count = read( client.fd, chunk, sizeof( chunk ) );
+		if ( count < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( count < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+			return true;
+		}
+		if ( count <= 0 ) {
+			return false;
+		}
+		client.input.insert( client.input.end(), chunk, chunk + count );
+		return true;
+	}
+}
+
+// Write the pending reply as far as the socket takes it without blocking, and answer the next whole frame each time
+// the reply is out. A client only gets its next frame answered once it has taken the last reply, so a slow reader
+// holds one reply in memory and stalls nobody else. False once the connection should be closed.
+static bool serve( Daemon &daemon, Client &client )
+{
+	for ( ;; ) {
+		while ( client.sent < client.output.size() ) {
+			ssize_t written = write( client.fd, client.output.data() + client.sent, client.output.size() - client.sent );
+			if ( written < 0 && errno == EINTR ) {
+				continue;
+			}
+			if ( written < 0 && ( errno == EAGAIN || errno == EWOULDBLOCK ) ) {
+				return true;
+			}
+			if ( written <= 0 ) {
+				return false;
+			}
+			client.sent += written;
+		}
+		client.output.clear();
+		client.sent = 0;
+		uint32_t length;
+		size_t available = client.input.size() - client.consumed;
+		if ( daemon.shutdown || available < sizeof( length ) ) {
+			return true;
+		}
+		std::memcpy( &length, client.input.data() + client.consumed, sizeof( length ) );
+		if ( length > maxFrameBytes ) {
+			return false;
+		}
+		if ( available - sizeof( length ) < length ) {
+			return true;
+		}
+		const char *frame = client.input.data() + client.consumed + sizeof( length );
+		FrameReader in{ frame, frame + length };
+		FrameWriter reply;
+		daemon.handle( in, reply );
+		client.consumed += sizeof( length ) + length;
+		uint32_t replyLength = reply.bytes.size();
+		client.output.resize( sizeof( replyLength ) );
+		std::memcpy( client.output.data(), &replyLength, sizeof( replyLength ) );
+		client.output.insert( client.output.end(), reply.bytes.begin(), reply.bytes.end() );
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	std::string socketPath = "aarf.sock", layoutPath;
+	std::vector<double> generate{ 1000, 1000, 100, 100 };
+	unsigned seed = 1, threads = 1;
+	bool repair = false;
+	// std::stod and std::stoul throw on text that is not a number
+	try {
+		for ( int i = 1; i < argc; ++i ) {
+			auto hasValue = i + 1 < argc;
+			if ( !strcmp( argv[i], "--socket" ) && hasValue ) {
+				socketPath = argv[++i];
+			} else if ( !strcmp( argv[i], "--layout" ) && hasValue ) {
+				layoutPath = argv[++i];
+			} else if ( !strcmp( argv[i], "--generate" ) && hasValue ) {
+				generate.clear();
+				std::stringstream ss( argv[++i] );
+				for ( std::string item; std::getline( ss, item, ',' ); ) {
+					generate.push_back( std::stod( item ) );
+				}
+			} else if ( !strcmp( argv[i], "--seed" ) && hasValue ) {
+				seed = std::stoul( argv[++i] );
+			} else if ( !strcmp( argv[i], "--threads" ) && hasValue ) {
+				threads = std::stoul( argv[++i] );
+			} else if ( !strcmp( argv[i], "--repair" ) ) {
+				repair = true;
+			} else {
+				usage( argv[0] );
+				return 1;
+			}
+		}
+	} catch ( const std::exception & ) {
+		usage( argv[0] );
+		return 1;
+	}
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	if ( generate.size() != 4 || socketPath.size() >= sizeof( address.sun_path ) ) {
+		usage( argv[0] );
+		return 1;
+	}
+
+	Stopwatch watch;
+	std::unique_ptr<Graph> graph( layoutPath.empty() ? generateRandomGraph( generate[0], generate[1], generate[2], generate[3], seed ) : loadGraph( layoutPath.c_str() ) );
+	if ( !graph ) {
+		std::cerr << "cannot load " << layoutPath << "\n";
+		return 1;
+	}
+	if ( !layoutPath.empty() ) {
+		auto report = validateGraph( *graph, 1 );
+		if ( !report.valid() && !repair ) {
+			const auto &issue = report.issues.front();
+			std::cerr << layoutPath << ": " << issueName( issue.kind ) << " " << issue.item << " " << issue.other << ", serve it with --repair\n";
+			return 1;
+		}
+		if ( !report.valid() ) {
+			graph.reset( repairGraph( *graph ) );
+		}
+	}
+	CDTOptions cdtOptions;
+	cdtOptions.threads = threads;
+	RouteOptions routeOptions;
+	routeOptions.threads = threads;
+	Daemon daemon( graph.get(), cdtOptions, routeOptions );
+
+	int listener = socket( AF_UNIX, SOCK_STREAM, 0 );
+	std::strcpy( address.sun_path, socketPath.c_str() );
+	unlink( socketPath.c_str() );
+	if ( listener < 0 || bind( listener, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) < 0 || listen( listener, 16 ) < 0 ) {
+		std::perror( socketPath.c_str() );
+		return 1;
+	}
+	// A client leaving mid-reply must not take the daemon down
+	std::signal( SIGPIPE, SIG_IGN );
+	std::cerr << "serving " << graph->getObstacles().size() << " obstacles and " << graph->getNets().size() << " nets on " << socketPath << ", ready in "
+			  << watch.elapsed() << "s\n";
+
+	// Client sockets are non-blocking. A client is polled for input while it has no reply pending and for output
+	// while it has, see serve.
+	std::vector<Client> clients;
+	while ( !daemon.shutdown ) {
+		std::vector<pollfd> fds{ { listener, POLLIN, 0 } };
+		for ( const auto &client : clients ) {
+			fds.push_back( { client.fd, static_cast<short>( client.output.empty() ? POLLIN : POLLOUT ), 0 } );
+		}
+		if ( poll( fds.data(), fds.size(), -1 ) < 0 ) {
+			if ( errno == EINTR ) {
+				continue;
+			}
+			std::perror( "poll" );
+			break;
+		}
+		for ( size_t k = fds.size() - 1; k > 0; --k ) {
+			if ( !fds[k].revents ) {
+				continue;
+			}
+			auto &client = clients[k - 1];
+			bool open = ( !client.output.empty() || receive( client ) ) && serve( daemon, client );
+			if ( !open ) {
+				close( client.fd );
+				clients.erase( clients.begin() + ( k - 1 ) );
+			}
+		}
+		if ( fds[0].revents & POLLIN ) {
+			int fd = accept( listener, nullptr, nullptr );
+			if ( fd >= 0 && fcntl( fd, F_SETFL, fcntl( fd, F_GETFL ) | O_NONBLOCK ) == 0 ) {
+				clients.emplace_back().fd = fd;
+			} else if ( fd >= 0 ) {
+				close( fd );
+			}
+		}
+	}
+	// Pending replies get what the sockets take without blocking, a client that stopped reading does not hold up the
+	// exit. The batch that asked for the shutdown was written when it was answered.
+	for ( auto &client : clients ) {
+		serve( daemon, client );
+		close( client.fd );
+	}
+	close( listener );
+	unlink( socketPath.c_str() );
+	return 0;
+}
@@ -0,0 +1,155 @@
+#include "geometry.h"
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#define AARF_AVX2_KERNELS 1
+#include <immintrin.h>
+#else
+#define AARF_AVX2_KERNELS 0
+#endif
+
+namespace
+{
+	// Float coordinates are widened for the arithmetic and rounded once when stored
+	template<typename Scalar>
+	void divideScalar( Scalar *x, Scalar *y, size_t begin, size_t count, double divisor )
+	{
+		for ( size_t i = begin; i < count; ++i ) {
+			x[i] = x[i] / divisor;
+			y[i] = y[i] / divisor;
+		}
+	}
+	template<typename Scalar>
+	void multiplyScalar( Scalar *x, Scalar *y, size_t begin, size_t count, double factor )
+	{
+		for ( size_t i = begin; i < count; ++i ) {
+			x[i] = x[i] * factor;
+			y[i] = y[i] * factor;
+		}
+	}
+	template<typename Scalar>
+	void binKeysScalar( const Scalar *x, const Scalar *y, int *key, size_t begin, size_t count, int ndiv, double k )
+	{
+		for ( size_t i = begin; i < count; ++i ) {
+			int row = y[i] * k;
+			int column = x[i] * k;
+			key[i] = row & 1 ? row * ndiv + column + 1 : ( row + 1 ) * ndiv - column;
+		}
+	}
+	bool anyContainsScalar( const RectBuffer &rects, size_t begin, size_t end, double x, double y )
+	{
+		for ( size_t i = begin; i < end; ++i ) {
+			if ( x > rects.x1[i] && x < rects.x2[i] && y > rects.y1[i] && y < rects.y2[i] ) {
+				return true;
+			}
+		}
+		return false;
+	}
+
+#if AARF_AVX2_KERNELS
+	bool hasAvx2()
+	{
+		static const bool supported = __builtin_cpu_supports( "avx2" );
+		return supported;
+	}
+
+	// Four doubles per step, the remainder goes through the scalar loop
+	__attribute__( ( target( "avx2" ) ) ) void divideAvx2( double *x, double *y, size_t count, double divisor )
+	{
+		__m256d d = _mm256_set1_pd( divisor );
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			_mm256_storeu_pd( x + i, _mm256_div_pd( _mm256_loadu_pd( x + i ), d ) );
+			_mm256_storeu_pd( y + i, _mm256_div_pd( _mm256_loadu_pd( y + i ), d ) );
+		}
+		divideScalar( x, y, i, count, divisor );
+	}
+	__attribute__( ( target( "avx2" ) ) ) void multiplyAvx2( double *x, double *y, size_t count, double factor )
+	{
+		__m256d f = _mm256_set1_pd( factor );
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			_mm256_storeu_pd( x + i, _mm256_mul_pd( _mm256_loadu_pd( x + i ), f ) );
+			_mm256_storeu_pd( y + i, _mm256_mul_pd( _mm256_loadu_pd( y + i ), f ) );
+		}
+		multiplyScalar( x, y, i, count, factor );
+	}
+	__attribute__( ( target( "avx2" ) ) ) void binKeysAvx2( const double *x, const double *y, int *key, size_t count, int ndiv, double k )
+	{
+		__m256d scale = _mm256_set1_pd( k );
+		__m128i n = _mm_set1_epi32( ndiv ), one = _mm_set1_epi32( 1 );
+		size_t i = 0;
+		for ( ; i + 4 <= count; i += 4 ) {
+			// Truncating conversions, like the casts of the scalar version
+			__m128i row = _mm256_cvttpd_epi32( _mm256_mul_pd( _mm256_loadu_pd( y + i ), scale ) );
+			__m128i column = _mm256_cvttpd_epi32( _mm256_mul_pd( _mm256_loadu_pd( x + i ), scale ) );
+			__m128i odd = _mm_sub_epi32( _mm_setzero_si128(), _mm_and_si128( row, one ) );
+			__m128i forward = _mm_add_epi32( _mm_add_epi32( _mm_mullo_epi32( row, n ), column ), one );
+			__m128i backward = _mm_sub_epi32( _mm_mullo_epi32( _mm_add_epi32( row, one ), n ), column );
+			_mm_storeu_si128( reinterpret_cast<__m128i *>( key + i ), _mm_blendv_epi8( backward, forward, odd ) );
+		}
+		binKeysScalar( x, y, key, i, count, ndiv, k );
+	}
+	__attribute__( ( target( "avx2" ) ) ) bool anyContainsAvx2( const RectBuffer &rects, size_t begin, size_t end, double x, double y )
+	{
+		__m256d px = _mm256_set1_pd( x ), py = _mm256_set1_pd( y );
+		size_t i = begin;
+		for ( ; i + 4 <= end; i += 4 ) {
+			__m256d inside = _mm256_and_pd( _mm256_and_pd( _mm256_cmp_pd( px, _mm256_loadu_pd( &rects.x1[i] ), _CMP_GT_OQ ), _mm256_cmp_pd( px, _mm256_loadu_pd( &rects.x2[i] ), _CMP_LT_OQ ) ),
+											_mm256_and_pd( _mm256_cmp_pd( py, _mm256_loadu_pd( &rects.y1[i] ), _CMP_GT_OQ ), _mm256_cmp_pd( py, _mm256_loadu_pd( &rects.y2[i] ), _CMP_LT_OQ ) ) );
+			if ( _mm256_movemask_pd( inside ) ) {
+				return true;
+			}
+		}
+		return anyContainsScalar( rects, i, end, x, y );
+	}
+#endif
+} // namespace
+
+void divideCoordinates( double *x, double *y, size_t count, double divisor )
+{
+#if AARF_AVX2_KERNELS
+	if ( hasAvx2() ) {
+		return divideAvx2( x, y, count, divisor );
+	}
+#endif
+	divideScalar( x, y, 0, count, divisor );
+}
+void divideCoordinates( float *x, float *y, size_t count, double divisor )
+{
+	divideScalar( x, y, 0, count, divisor );
+}
+void multiplyCoordinates( double *x, double *y, size_t count, double factor )
+{
+#if AARF_AVX2_KERNELS
+	if ( hasAvx2() ) {
+		return multiplyAvx2( x, y, count, factor );
+	}
+#endif
+	multiplyScalar( x, y, 0, count, factor );
+}
+void multiplyCoordinates( float *x, float *y, size_t count, double factor )
+{
+	multiplyScalar( x, y, 0, count, factor );
+}
+void binKeys( const double *x, const double *y, int *key, size_t count, int ndiv, double k )
+{
+#if AARF_AVX2_KERNELS
+	if ( hasAvx2() ) {
+		return binKeysAvx2( x, y, key, count, ndiv, k );
+	}
+#endif
+	binKeysScalar( x, y, key, 0, count, ndiv, k );
+}
+void binKeys( const float *x, const float *y, int *key, size_t count, int ndiv, double k )
+{
+	binKeysScalar( x, y, key, 0, count, ndiv, k );
+}
+bool anyContains( const RectBuffer &rects, size_t begin, size_t end, double x, double y )
+{
+#if AARF_AVX2_KERNELS
+	if ( hasAvx2() ) {
+		return anyContainsAvx2( rects, begin, end, x, y );
+	}
+#endif
+	return anyContainsScalar( rects, begin, end, x, y );
+}
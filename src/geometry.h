@@ -0,0 +1,99 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// Plain geometry types and batch kernels over coordinate arrays.
+// Kernels have an AVX2 version picked at run time on x86 CPUs that support it and a scalar one everywhere else;
+// both give bit-identical results. The float overloads, for compact node buffers, are scalar only.
+
+struct Vec2 {
+	double x, y;
+};
+
+// Axis-aligned rectangle from (x1, y1) to (x2, y2), x1 <= x2 and y1 <= y2
+struct Rect {
+	double x1, y1, x2, y2;
+
+	// Strictly inside, points on the border are not contained
+	bool contains( double x, double y ) const { return x > x1 && x < x2 && y > y1 && y < y2; }
+	// Interiors overlap
+	bool intersects( const Rect &other ) const { return other.x1 < x2 && other.y1 < y2 && other.x2 > x1 && other.y2 > y1; }
+};
+
+// Nodes as structure of arrays: coordinates and a per-node integer key (bin or strip) used while sorting.
+// Scalar is the storage type of the coordinates; they are read back as doubles, so arithmetic on float nodes is
+// carried out in double precision.
+template<typename Scalar>
+struct BasicNodeBuffer {
+	std::vector<Scalar> x, y;
+	std::vector<int> key;
+
+	size_t size() const { return x.size(); }
+	Vec2 operator[]( size_t i ) const { return { x[i], y[i] }; }
+	void push( double px, double py )
+	{
+		x.push_back( px );
+		y.push_back( py );
+		key.push_back( 0 );
+	}
+	void reserve( size_t count )
+	{
+		x.reserve( count );
+		y.reserve( count );
+		key.reserve( count );
+	}
+	void clear()
+	{
+		x.clear();
+		y.clear();
+		key.clear();
+	}
+	size_t capacityBytes() const { return ( x.capacity() + y.capacity() ) * sizeof( Scalar ) + key.capacity() * sizeof( int ); }
+	// Node order[i] becomes node i. The old arrays end up in scratch, to be reused by the next call.
+	template<typename Index>
+	void permute( const std::vector<Index> &order, BasicNodeBuffer &scratch )
+	{
+		scratch.x.resize( order.size() );
+		scratch.y.resize( order.size() );
+		scratch.key.resize( order.size() );
+		for ( size_t i = 0; i < order.size(); ++i ) {
+			scratch.x[i] = x[order[i]];
+			scratch.y[i] = y[order[i]];
+			scratch.key[i] = key[order[i]];
+		}
+		x.swap( scratch.x );
+		y.swap( scratch.y );
+		key.swap( scratch.key );
+	}
+};
+
+using NodeBuffer = BasicNodeBuffer<double>;
+
+// Rectangles as structure of arrays
+struct RectBuffer {
+	std::vector<double> x1, y1, x2, y2;
+
+	size_t size() const { return x1.size(); }
+	Rect operator[]( size_t i ) const { return { x1[i], y1[i], x2[i], y2[i] }; }
+	void push( const Rect &r )
+	{
+		x1.push_back( r.x1 );
+		y1.push_back( r.y1 );
+		x2.push_back( r.x2 );
+		y2.push_back( r.y2 );
+	}
+};
+
+// x[i] /= divisor and y[i] /= divisor
+void divideCoordinates( double *x, double *y, size_t count, double divisor );
+void divideCoordinates( float *x, float *y, size_t count, double divisor );
+// x[i] *= factor and y[i] *= factor
+void multiplyCoordinates( double *x, double *y, size_t count, double factor );
+void multiplyCoordinates( float *x, float *y, size_t count, double factor );
+// Boustrophedon bin of every point of the unit square on an ndiv x ndiv grid scaled by k, rows alternate direction
+// so consecutive bins are neighbours
+void binKeys( const double *x, const double *y, int *key, size_t count, int ndiv, double k );
+void binKeys( const float *x, const float *y, int *key, size_t count, int ndiv, double k );
+// Whether any of the rectangles [begin, end) contains (x, y)
+bool anyContains( const RectBuffer &rects, size_t begin, size_t end, double x, double y );
@@ -1,68 +1,74 @@
 #include "graph.h"
+#include "geometry.h"
 #include "util.h"
-#include <QPainterPath>
+#include <algorithm>
+#include <cassert>
 #include <cmath>
+#include <iterator>
 #include <utility>
-void Graph::paint( QPainter *painter )
-{
-	painter->setPen( QPen( Qt::black, 1 ) );
-	painter->setBrush( Qt::white );
-	painter->drawRect( 0, 0, width, height );
-	painter->setBrush( Qt::black );
-	for ( auto [pa, pb] : obstacles ) {
-		auto [ax, ay] = pa;
-		auto [bx, by] = pb;
-		painter->fillRect( ax, ay, bx - ax, by - ay, Qt::black );
-	}
-	for ( auto [pa, pb] : nets ) {
-		auto [ax, ay] = pa;
-		auto [bx, by] = pb;
-		const double radius = 1;
-		painter->drawEllipse( { ax, ay }, radius, radius );
-		painter->drawEllipse( { bx, by }, radius, radius );
-	}
-	painter->setPen( QPen( Qt::gray, 2 ) );
-	for ( auto [pa, pb] : cdt_edges ) {
-		auto [ax, ay] = pa;
-		auto [bx, by] = pb;
-		painter->drawLine( ax, ay, bx, by );
-	}
-	painter->setPen( QPen( Qt::red, 4 ) );
-	for ( auto &route : routes ) {
-		QPainterPath path;
-		bool first = true;
-		for ( auto [x, y] : route ) {
-			first ? path.moveTo( x, y ) : path.lineTo( x, y );
-			first = false;
-		}
-		painter->drawPath( path );
-	}
-}
 Graph::Graph( double width, double height, std::vector<TwoPoints> obstacles, std::vector<TwoPoints> nets )
-	: width( width ), height( height ), obstacles( std::move( obstacles ) ), nets( std::move( nets ) ), cdt_edges(), routes( nets.size() )
-{
-#define CHECK_POINT( P )                        \
-	auto [P##_x, P##_y] = P;                    \
-	assert( ( P##_x >= 0 && P##_x <= width ) ); \
-	assert( ( P##_y >= 0 && P##_y <= width ) )
-#define CHECK_REC( PA, PB )    \
-	CHECK_POINT( PA );         \
-	CHECK_POINT( PB );         \
-	assert( PB##_x > PA##_x ); \
-	assert( PB##_y > PA##_y )
-
+	: width( width ), height( height ), obstacles( std::move( obstacles ) ), nets( std::move( nets ) ), cdt_edges(), routes( this->nets.size() )
+{
+	// Only the die is checked, obstacles and nets may come from a file and are reported by validateGraph
 	assert( width > 0 );
 	assert( height > 0 );
-	for ( auto [pa, pb] : obstacles ) {
-		CHECK_REC( pa, pb );
-	}
-	for ( auto [pa, pb] : nets ) {
-		CHECK_POINT( pa );
-		CHECK_POINT( pb );
+}
+Graph::Graph( const Graph &other )
+	: width( other.width ), height( other.height ), obstacles( other.obstacles ), nets( other.nets ), cdt_edges( other.cdt_edges ), routes( other.routes )
+{
+}
+int Graph::addObstacle( TwoPoints obstacle )
+{
+	obstacles.push_back( obstacle );
+	notify( { GraphChange::Kind::AddObstacle, static_cast<int>( obstacles.size() ) - 1, {} } );
+	return obstacles.size() - 1;
+}
+void Graph::removeObstacle( int index )
+{
+	assert( ( index >= 0 && index < obstacles.size() ) );
+	auto previous = obstacles[index];
+	obstacles[index] = obstacles.back();
+	obstacles.pop_back();
+	notify( { GraphChange::Kind::RemoveObstacle, index, previous } );
+}
+void Graph::moveObstacle( int index, TwoPoints obstacle )
+{
+	assert( ( index >= 0 && index < obstacles.size() ) );
+	auto previous = obstacles[index];
+	obstacles[index] = obstacle;
+	notify( { GraphChange::Kind::MoveObstacle, index, previous } );
+}
+int Graph::addNet( TwoPoints net )
+{
+	nets.push_back( net );
+	routes.emplace_back();
+	notify( { GraphChange::Kind::AddNet, static_cast<int>( nets.size() ) - 1, {} } );
+	return nets.size() - 1;
+}
+void Graph::removeNet( int index )
+{
+	assert( ( index >= 0 && index < nets.size() ) );
+	auto previous = nets[index];
+	nets[index] = nets.back();
+	nets.pop_back();
+	std::swap( routes[index], routes.back() );
+	routes.pop_back();
+	notify( { GraphChange::Kind::RemoveNet, index, previous } );
+}
+int Graph::subscribe( GraphListener listener )
+{
+	listeners.emplace_back( next_listener, std::move( listener ) );
+	return next_listener++;
+}
+void Graph::unsubscribe( int id )
+{
+	listeners.erase( std::remove_if( listeners.begin(), listeners.end(), [id]( const auto &entry ) { return std::get<0>( entry ) == id; } ), listeners.end() );
+}
+void Graph::notify( const GraphChange &change )
+{
+	for ( auto &[id, listener] : listeners ) {
+		listener( change );
 	}
-
-#undef CHECK_POINT
-#undef CHECK_REC
 }
 void Graph::setCdtEdges( std::vector<TwoPoints> cdt_edges )
 {
@@ -98,66 +104,145 @@ const std::vector<std::vector<Point>> &Graph::getRoutes() const
 	return routes;
 }
 
-inline bool inRectangle( TwoPoints &rec, Point &point )
+// Uniform grid over the die listing every obstacle in each cell it overlaps. While obstacles are added the cells
+// are singly linked lists; pack() then copies each cell's rectangles into one contiguous run for covers().
+class ObstacleGrid
 {
-	auto [p1, p2] = rec;
-	auto [x, y] = point;
-	auto [x1, y1] = p1;
-	auto [x2, y2] = p2;
-	return x > x1 && x < x2 && y > y1 && y < y2;
-}
+public:
+	ObstacleGrid( double width, double height, int expected )
+	{
+		// Cells at least as large as the biggest generated obstacle, so one overlaps at most 2 x 2 cells
+		columns = rows = std::max( 1, static_cast<int>( std::sqrt( expected ) ) );
+		cellWidth = width / columns, cellHeight = height / rows;
+		heads.assign( static_cast<size_t>( columns ) * rows, -1 );
+	}
+	bool overlaps( const Rect &rec ) const
+	{
+		bool found = false;
+		forCells( rec, [&]( size_t cell ) {
+			for ( int e = heads[cell]; e != -1 && !found; e = entries[e].next ) {
+				found = rec.intersects( rects[entries[e].obstacle] );
+			}
+		} );
+		return found;
+	}
+	// Only after pack()
+	bool covers( double x, double y ) const
+	{
+		size_t cell = cellOf( x, y );
+		return anyContains( packed, starts[cell], starts[cell + 1], x, y );
+	}
+	void add( const Rect &rec )
+	{
+		int obstacle = obstacles.size();
+		obstacles.push_back( { { rec.x1, rec.y1 }, { rec.x2, rec.y2 } } );
+		rects.push_back( rec );
+		forCells( rec, [&]( size_t cell ) {
+			entries.push_back( { obstacle, heads[cell] } );
+			heads[cell] = entries.size() - 1;
+		} );
+	}
+	void pack()
+	{
+		starts.assign( heads.size() + 1, 0 );
+		for ( size_t cell = 0; cell < heads.size(); ++cell ) {
+			starts[cell + 1] = starts[cell];
+			for ( int e = heads[cell]; e != -1; e = entries[e].next ) {
+				packed.push( rects[entries[e].obstacle] );
+				++starts[cell + 1];
+			}
+		}
+	}
+	std::vector<TwoPoints> obstacles;
 
-inline bool isIntersect( TwoPoints &rec1, TwoPoints &rec2 )
-{
-#define X( P ) ( std::get<0>( P ) )
-#define Y( P ) ( std::get<1>( P ) )
-	auto [p11, p12] = rec1;
-	auto [p21, p22] = rec2;
-	return X( p21 ) < X( p12 ) && Y( p21 ) < Y( p12 ) && X( p22 ) > X( p11 ) && Y( p22 ) > Y( p11 );
-#undef X
-#undef Y
-}
+private:
+	struct Entry {
+		int obstacle, next;
+	};
+	int column( double x ) const { return std::clamp( static_cast<int>( x / cellWidth ), 0, columns - 1 ); }
+	int row( double y ) const { return std::clamp( static_cast<int>( y / cellHeight ), 0, rows - 1 ); }
+	size_t cellOf( double x, double y ) const { return static_cast<size_t>( row( y ) ) * columns + column( x ); }
+	template<typename Visit>
+	void forCells( const Rect &rec, Visit visit ) const
+	{
+		for ( int j = row( rec.y1 ); j <= row( rec.y2 ); ++j ) {
+			for ( int i = column( rec.x1 ); i <= column( rec.x2 ); ++i ) {
+				visit( static_cast<size_t>( j ) * columns + i );
+			}
+		}
+	}
+
+	int columns, rows;
+	double cellWidth, cellHeight;
+	std::vector<int> heads;
+	std::vector<Entry> entries;
+	std::vector<Rect> rects;
+	RectBuffer packed;
+	std::vector<size_t> starts;
+};
 
-Graph *generateRandomGraph( double width, double height, int obsCount, int netCount )
+Graph *generateRandomGraph( double width, double height, int obsCount, int netCount, unsigned seed, const GenerateOptions &options )
 {
-	RandomUniformReal rd1( 0, 1 );
-	RandomNormalReal rd2( 0, 1 );
-	// Plain O(N^2) Algorithm
-	std::vector<TwoPoints> obstacles;
+	// Obstacle corners, obstacle sizes and every chunk of nets draw from their own stream of the seed
+	RandomStream streams( seed );
+	RandomUniformReal rd1( 0, 1, streams.split( 0 ) );
+	RandomNormalReal rd2( 0, 1, streams.split( 1 ) );
+	// Rejection sampling, overlap tests only look at obstacles sharing a grid cell
+	ObstacleGrid grid( width, height, obsCount );
 	double areaFactor = 1.0 / sqrt( 2 * obsCount );
 	for ( int i = 0; i < obsCount; i++ ) {
-		bool pushed = false;
-		while ( !pushed ) {
-			pushed = true;
-			double x = rd1() * width, y = rd1() * height, w = std::min( rd2() * width * areaFactor, width - x ), h = std::min( rd2() * height * areaFactor, height - y );
-			TwoPoints rec( { x, y }, { x + w, y + h } );
-			for ( auto &other : obstacles ) {
-				if ( isIntersect( rec, other ) ) {
-					pushed = false;
-					break;
-				}
+		if ( i % 1024 == 0 ) {
+			if ( jobCancelled( options.control ) ) {
+				return nullptr;
 			}
-			if ( pushed ) {
-				obstacles.push_back( rec );
+			reportProgress( options.control, "obstacles", static_cast<double>( i ) / obsCount );
+		}
+		for ( int attempt = 0; attempt < options.maxAttempts; attempt++ ) {
+			double x = rd1() * width, y = rd1() * height, w = std::min( rd2() * width * areaFactor, width - x ), h = std::min( rd2() * height * areaFactor, height - y );
+			Rect rec{ x, y, x + w, y + h };
+			if ( !grid.overlaps( rec ) ) {
+				grid.add( rec );
+				break;
 			}
 		}
 	}
-	std::vector<TwoPoints> nets;
-	for ( int i = 0; i < netCount; i++ ) {
-		bool pushed = false;
-		while ( !pushed ) {
-			pushed = true;
-			Point p1( rd1() * width, rd1() * height ), p2( rd1() * width, rd1() * height );
-			for ( auto &rec : obstacles ) {
-				if ( inRectangle( rec, p1 ) || inRectangle( rec, p2 ) ) {
-					pushed = false;
-					break;
+	grid.pack();
+	reportProgress( options.control, "nets", 0 );
+	// Pins only read the grid, so chunks of nets are drawn concurrently
+	constexpr int chunkSize = 1 << 16;
+	int chunkCount = ( netCount + chunkSize - 1 ) / chunkSize;
+	std::vector<std::vector<TwoPoints>> chunks( chunkCount );
+	parallelFor( options.threads, chunkCount, [&]( size_t begin, size_t end ) {
+		for ( size_t chunk = begin; chunk < end && !jobCancelled( options.control ); ++chunk ) {
+			RandomUniformReal rd( 0, 1, streams.split( 2 + chunk ) );
+			int count = std::min( chunkSize, netCount - static_cast<int>( chunk ) * chunkSize );
+			// Candidate pins are drawn a block at a time, in the order single draws would give them
+			double values[1024];
+			size_t next = std::size( values );
+			for ( int i = 0; i < count; i++ ) {
+				for ( int attempt = 0; attempt < options.maxAttempts; attempt++ ) {
+					if ( next == std::size( values ) ) {
+						rd.fill( values, std::size( values ) );
+						next = 0;
+					}
+					const double *v = values + next;
+					next += 4;
+					Point p1( v[0] * width, v[1] * height ), p2( v[2] * width, v[3] * height );
+					if ( !grid.covers( std::get<0>( p1 ), std::get<1>( p1 ) ) && !grid.covers( std::get<0>( p2 ), std::get<1>( p2 ) ) ) {
+						chunks[chunk].emplace_back( p1, p2 );
+						break;
+					}
 				}
 			}
-			if ( pushed ) {
-				nets.emplace_back( p1, p2 );
-			}
 		}
+	} );
+	if ( jobCancelled( options.control ) ) {
+		return nullptr;
+	}
+	std::vector<TwoPoints> nets;
+	nets.reserve( netCount );
+	for ( auto &chunk : chunks ) {
+		nets.insert( nets.end(), chunk.begin(), chunk.end() );
 	}
-	return new Graph( width, height, obstacles, nets );
+	return new Graph( width, height, std::move( grid.obstacles ), std::move( nets ) );
 }
@@ -1,17 +1,51 @@
 #pragma once
-#include <QPainter>
+#include "job.h"
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <random>
 #include <tuple>
 #include <vector>
 
 using Point = std::tuple<double, double>;
 using TwoPoints = std::tuple<Point, Point>;
 
+// An edit applied to a Graph, passed to its listeners once the graph has changed
+struct GraphChange {
+	enum class Kind
+	{
+		AddObstacle,
+		RemoveObstacle,
+		MoveObstacle,
+		AddNet,
+		RemoveNet
+	};
+	Kind kind;
+	// Index of the edited obstacle or net. Removals move the last item into this index.
+	int index;
+	// Geometry before a removal or a move
+	TwoPoints previous;
+};
+using GraphListener = std::function<void( const GraphChange & )>;
+
 class Graph
 {
 public:
-	void paint( QPainter *painter );
+	// Takes the geometry as it is, validateGraph reports what the triangulation cannot take
 	Graph( double width, double height, std::vector<TwoPoints> obstacles, std::vector<TwoPoints> nets );
-	Graph( const Graph &other ) = default;
+	// Copies do not inherit the listeners: a DynamicCDT, or any other subscriber, keeps following the original and
+	// never sees edits made to the copy. Assignment is not offered for the same reason.
+	Graph( const Graph &other );
+	Graph &operator=( const Graph & ) = delete;
+	// Edits, each one notifies the listeners. CDT edges and routes are left as they are.
+	int addObstacle( TwoPoints obstacle );
+	void removeObstacle( int index );
+	void moveObstacle( int index, TwoPoints obstacle );
+	int addNet( TwoPoints net );
+	void removeNet( int index );
+	// Returns an id for unsubscribe()
+	int subscribe( GraphListener listener );
+	void unsubscribe( int id );
 	void setCdtEdges( std::vector<TwoPoints> cdt_edges );
 	void setRoute( int netId, std::vector<Point> route );
 	double getWidth() const;
@@ -25,6 +59,82 @@ private:
 	double width, height;
 	std::vector<TwoPoints> obstacles, nets, cdt_edges;
 	std::vector<std::vector<Point>> routes;
+	std::vector<std::tuple<int, GraphListener>> listeners;
+	int next_listener = 0;
+	void notify( const GraphChange &change );
+};
+
+struct GenerateOptions {
+	// Candidates tried per obstacle or net before it is dropped, so dense requests return fewer items instead of
+	// retrying forever
+	int maxAttempts = 1000;
+	// Nets are drawn in fixed-size chunks with their own seeds, so the result does not depend on the thread count
+	unsigned threads = 1;
+	// Optional progress and cancellation
+	JobControl *control = nullptr;
+};
+
+// Returns nullptr if options.control cancels the run
+Graph *generateRandomGraph( double width, double height, int obsCount, int netCount, unsigned seed = std::random_device{}(), const GenerateOptions &options = {} );
+
+// Input geometry the triangulation cannot take as it is, found by validateGraph
+struct GraphIssue {
+	enum class Kind
+	{
+		// A corner outside the die, or not a number
+		ObstacleOutOfBounds,
+		// x2 <= x1 or y2 <= y1
+		EmptyObstacle,
+		// Interiors intersect, obstacles only sharing a side or a corner are fine
+		OverlappingObstacles,
+		PinOutOfBounds,
+		// Strictly inside an obstacle, or on its border
+		PinInsideObstacle,
+		PinOnObstacle,
+		// Both pins at the same place
+		DegenerateNet,
+		// Same pins as an earlier net. Distinct nets sharing one pin are fine, the triangulation merges the two.
+		DuplicateNet,
+		Count
+	};
+	Kind kind;
+	// Obstacle index for obstacle kinds, pin 2 * net + side for pin kinds, net index for net kinds
+	int item;
+	// The other obstacle or net involved, the obstacle for pin kinds, -1 when there is none
+	int other;
+};
+
+const char *issueName( GraphIssue::Kind kind );
+
+struct GraphReport {
+	// The first issues found, up to the limit given to validateGraph
+	std::vector<GraphIssue> issues;
+	// Issues of every kind, including those not listed
+	std::array<size_t, static_cast<size_t>( GraphIssue::Kind::Count )> counts{};
+
+	size_t count( GraphIssue::Kind kind ) const { return counts[static_cast<size_t>( kind )]; }
+	bool valid() const
+	{
+		for ( auto n : counts ) {
+			if ( n > 0 ) {
+				return false;
+			}
+		}
+		return true;
+	}
+};
+
+// Finds every issue of graph in O( ( n + k ) log n ) for n obstacles and pins and k overlaps: sweeps along x keep
+// the open obstacles in a max tree over their y ranges, so each overlap query only descends into matching subtrees.
+GraphReport validateGraph( const Graph &graph, size_t maxIssues = 1024 );
+
+struct RepairStats {
+	size_t clampedObstacles = 0, droppedObstacles = 0, mergedObstacles = 0;
+	size_t clampedPins = 0, movedPins = 0, droppedNets = 0;
 };
 
-Graph *generateRandomGraph( double width, double height, int obsCount, int netCount );
\ No newline at end of file
+// A copy of graph that validateGraph accepts. Obstacles are clipped to the die, empty ones dropped, and overlapping
+// ones replaced by their bounding box until none overlap. Pins are clamped to the die and pins inside or on an
+// obstacle moved just outside its nearest side; nets that stay blocked, degenerate nets and duplicate nets are
+// dropped. Listeners, CDT edges and routes are not copied.
+Graph *repairGraph( const Graph &graph, RepairStats *stats = nullptr );
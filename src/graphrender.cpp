@@ -1,27 +1,305 @@
 #include "graphrender.h"
+#include <QMouseEvent>
 #include <QPainter>
+#include <QWheelEvent>
+#include <algorithm>
+#include <cmath>
 
-void GraphRender::onGraphChanged( Graph *newGraph )
+// Items bucketed by bounding box on a uniform grid over the graph, so a paint only visits the cells in view. An
+// item spanning several cells is listed in each of them and reported once per query.
+struct SpatialGrid {
+	QRectF world;
+	int columns = 1, rows = 1;
+	double cell_width = 1, cell_height = 1;
+	// CSR layout: the items of cell c are cell_items[cell_start[c]..cell_start[c + 1])
+	std::vector<unsigned> cell_start, cell_items;
+	// Query stamp of every item, for deduplication
+	std::vector<unsigned> stamp;
+	unsigned current = 0;
+
+	// Inclusive range of cells touched by area, clamped to the grid
+	void cellRange( const QRectF &area, int &c0, int &r0, int &c1, int &r1 ) const
+	{
+		auto column = [&]( double x ) { return std::clamp( static_cast<int>( std::floor( ( x - world.left() ) / cell_width ) ), 0, columns - 1 ); };
+		auto row = [&]( double y ) { return std::clamp( static_cast<int>( std::floor( ( y - world.top() ) / cell_height ) ), 0, rows - 1 ); };
+		c0 = column( area.left() );
+		c1 = column( area.right() );
+		r0 = row( area.top() );
+		r1 = row( area.bottom() );
+	}
+
+	// bounds( i ) gives the bounding box of item i
+	template<typename Bounds>
+	void build( size_t count, const QRectF &area, Bounds bounds )
+	{
+		// About four items per cell, at most 1024 x 1024 cells
+		world = area;
+		columns = rows = std::clamp( static_cast<int>( std::sqrt( count / 4.0 ) ), 1, 1024 );
+		cell_width = std::max( world.width(), 1.0 ) / columns;
+		cell_height = std::max( world.height(), 1.0 ) / rows;
+		cell_start.assign( static_cast<size_t>( columns ) * rows + 1, 0 );
+		auto forCells = [&]( size_t i, auto &&body ) {
+			int c0, r0, c1, r1;
+			cellRange( bounds( i ), c0, r0, c1, r1 );
+			for ( int r = r0; r <= r1; ++r ) {
+				for ( int c = c0; c <= c1; ++c ) {
+					body( static_cast<size_t>( r ) * columns + c );
+				}
+			}
+		};
+		for ( size_t i = 0; i < count; ++i ) {
+			forCells( i, [&]( size_t cell ) { ++cell_start[cell + 1]; } );
+		}
+		for ( size_t c = 1; c < cell_start.size(); ++c ) {
+			cell_start[c] += cell_start[c - 1];
+		}
+		cell_items.resize( cell_start.back() );
+		std::vector<unsigned> fill( cell_start.begin(), cell_start.end() - 1 );
+		for ( size_t i = 0; i < count; ++i ) {
+			forCells( i, [&]( size_t cell ) { cell_items[fill[cell]++] = i; } );
+		}
+		stamp.assign( count, 0 );
+		current = 0;
+	}
+
+	// Calls visit( i ) once for every item listed in a cell that overlaps area
+	template<typename Visit>
+	void query( const QRectF &area, Visit &&visit )
+	{
+		if ( stamp.empty() || !area.intersects( world.adjusted( -cell_width, -cell_height, cell_width, cell_height ) ) ) {
+			return;
+		}
+		if ( ++current == 0 ) {
+			std::fill( stamp.begin(), stamp.end(), 0 );
+			current = 1;
+		}
+		int c0, r0, c1, r1;
+		cellRange( area, c0, r0, c1, r1 );
+		for ( int r = r0; r <= r1; ++r ) {
+			for ( int c = c0; c <= c1; ++c ) {
+				size_t cell = static_cast<size_t>( r ) * columns + c;
+				for ( unsigned k = cell_start[cell]; k < cell_start[cell + 1]; ++k ) {
+					unsigned i = cell_items[k];
+					if ( stamp[i] != current ) {
+						stamp[i] = current;
+						visit( i );
+					}
+				}
+			}
+		}
+	}
+};
+
+// Graph geometry converted to Qt types once per graph change, with one spatial index per layer. Paints are
+// culled to the visible area and skip or simplify what would cover less than a pixel.
+struct RenderCache {
+	static constexpr double pinRadius = 1;
+
+	QRectF world;
+	std::vector<QRectF> obstacles;
+	std::vector<QPointF> pins;
+	// CDT edges and route segments
+	std::vector<QLineF> edges, wires;
+	SpatialGrid obstacle_grid, pin_grid, edge_grid, wire_grid;
+	bool stale = true;
+	// Per paint scratch, kept to avoid reallocating every frame
+	std::vector<QRectF> rect_batch;
+	std::vector<QPointF> point_batch;
+	std::vector<QLineF> line_batch;
+
+	static QRectF lineBounds( const QLineF &line ) { return QRectF( line.p1(), line.p2() ).normalized(); }
+
+	void build( const Graph &graph )
+	{
+		world = QRectF( 0, 0, graph.getWidth(), graph.getHeight() );
+		obstacles.clear();
+		for ( auto [pa, pb] : graph.getObstacles() ) {
+			auto [ax, ay] = pa;
+			auto [bx, by] = pb;
+			obstacles.emplace_back( ax, ay, bx - ax, by - ay );
+		}
+		pins.clear();
+		for ( auto [pa, pb] : graph.getNets() ) {
+			pins.emplace_back( std::get<0>( pa ), std::get<1>( pa ) );
+			pins.emplace_back( std::get<0>( pb ), std::get<1>( pb ) );
+		}
+		edges.clear();
+		for ( auto [pa, pb] : graph.getCdtEdges() ) {
+			edges.emplace_back( std::get<0>( pa ), std::get<1>( pa ), std::get<0>( pb ), std::get<1>( pb ) );
+		}
+		wires.clear();
+		for ( auto &route : graph.getRoutes() ) {
+			for ( size_t i = 1; i < route.size(); ++i ) {
+				wires.emplace_back( std::get<0>( route[i - 1] ), std::get<1>( route[i - 1] ), std::get<0>( route[i] ), std::get<1>( route[i] ) );
+			}
+		}
+		obstacle_grid.build( obstacles.size(), world, [&]( size_t i ) { return obstacles[i].normalized(); } );
+		pin_grid.build( pins.size(), world, [&]( size_t i ) { return QRectF( pins[i].x() - pinRadius, pins[i].y() - pinRadius, 2 * pinRadius, 2 * pinRadius ); } );
+		edge_grid.build( edges.size(), world, [&]( size_t i ) { return lineBounds( edges[i] ); } );
+		wire_grid.build( wires.size(), world, [&]( size_t i ) { return lineBounds( wires[i] ); } );
+		stale = false;
+	}
+
+	// visible is in graph coordinates, scale in pixels per graph unit
+	void paint( QPainter &painter, const QRectF &visible, double scale )
+	{
+		painter.setPen( QPen( Qt::black, 1 ) );
+		painter.setBrush( Qt::white );
+		painter.drawRect( world );
+		// Obstacles and pins smaller than a pixel become one pixel dots
+		QPen dot( Qt::black, 1 );
+		dot.setCosmetic( true );
+
+		rect_batch.clear();
+		point_batch.clear();
+		obstacle_grid.query( visible, [&]( unsigned i ) {
+			const QRectF &r = obstacles[i];
+			if ( std::max( std::abs( r.width() ), std::abs( r.height() ) ) * scale < 1 ) {
+				point_batch.push_back( r.center() );
+			} else {
+				rect_batch.push_back( r );
+			}
+		} );
+		painter.setPen( Qt::NoPen );
+		painter.setBrush( Qt::black );
+		painter.drawRects( rect_batch.data(), static_cast<int>( rect_batch.size() ) );
+		painter.setPen( dot );
+		painter.drawPoints( point_batch.data(), static_cast<int>( point_batch.size() ) );
+
+		point_batch.clear();
+		pin_grid.query( visible, [&]( unsigned i ) { point_batch.push_back( pins[i] ); } );
+		if ( 2 * pinRadius * scale < 1 ) {
+			painter.drawPoints( point_batch.data(), static_cast<int>( point_batch.size() ) );
+		} else {
+			painter.setPen( QPen( Qt::black, 1 ) );
+			for ( auto &pin : point_batch ) {
+				painter.drawEllipse( pin, pinRadius, pinRadius );
+			}
+		}
+
+		// Sub-pixel CDT edges are skipped, at that zoom the mesh reads as a gray area anyway
+		line_batch.clear();
+		edge_grid.query( visible, [&]( unsigned i ) {
+			const QLineF &line = edges[i];
+			if ( std::max( std::abs( line.dx() ), std::abs( line.dy() ) ) * scale >= 1 ) {
+				line_batch.push_back( line );
+			}
+		} );
+		painter.setPen( QPen( Qt::gray, 2 ) );
+		painter.drawLines( line_batch.data(), static_cast<int>( line_batch.size() ) );
+
+		// Routes are drawn in full so they stay connected
+		line_batch.clear();
+		wire_grid.query( visible, [&]( unsigned i ) { line_batch.push_back( wires[i] ); } );
+		painter.setPen( QPen( Qt::red, 4, Qt::SolidLine, Qt::RoundCap, Qt::RoundJoin ) );
+		painter.drawLines( line_batch.data(), static_cast<int>( line_batch.size() ) );
+	}
+};
+
+GraphRender::GraphRender() : cache( std::make_unique<RenderCache>() ) {}
+
+GraphRender::~GraphRender()
+{
+	if ( graph != nullptr ) {
+		graph->unsubscribe( listener );
+	}
+}
+
+void GraphRender::onGraphChanged( std::shared_ptr<Graph> newGraph )
 {
-	graph = newGraph;
+	if ( graph != newGraph ) {
+		if ( graph != nullptr ) {
+			graph->unsubscribe( listener );
+		}
+		graph = std::move( newGraph );
+		// Edits may come from any thread, the cache and the widget are only touched on the GUI thread
+		listener = graph == nullptr ? -1 : graph->subscribe( [this]( const GraphChange & ) {
+			QMetaObject::invokeMethod(
+				this,
+				[this] {
+					cache->stale = true;
+					viewChanged();
+				},
+				Qt::QueuedConnection );
+		} );
+		view.reset();
+	}
+	cache->stale = true;
+	viewChanged();
+}
+
+void GraphRender::viewChanged()
+{
+	frame_valid = false;
 	update();
 }
 
-void GraphRender::paintEvent( QPaintEvent *event )
+QTransform GraphRender::worldTransform() const
+{
+	// Fit the graph into the widget keeping its aspect ratio, centered
+	double scale = std::min( width() / graph->getWidth(), height() / graph->getHeight() );
+	QTransform fit( scale, 0, 0, scale, ( width() - graph->getWidth() * scale ) / 2, ( height() - graph->getHeight() * scale ) / 2 );
+	return fit * view;
+}
+
+void GraphRender::paintEvent( QPaintEvent * )
 {
 	if ( graph == nullptr ) {
 		return;
 	}
+	if ( cache->stale ) {
+		cache->build( *graph );
+	}
 
+	qreal ratio = devicePixelRatioF();
+	if ( !frame_valid || frame.size() != size() * ratio ) {
+		frame = QPixmap( size() * ratio );
+		frame.setDevicePixelRatio( ratio );
+		frame.fill( Qt::transparent );
+		QPainter painter( &frame );
+		painter.setRenderHint( QPainter::Antialiasing );
+		QTransform transform = worldTransform();
+		painter.setTransform( transform );
+		cache->paint( painter, transform.inverted().mapRect( QRectF( rect() ) ), transform.m11() * ratio );
+		frame_valid = true;
+	}
 	QPainter painter( this );
-	painter.setRenderHint( QPainter::Antialiasing );
+	painter.drawPixmap( 0, 0, frame );
+}
+
+void GraphRender::wheelEvent( QWheelEvent *event )
+{
+	const double maxZoom = 1e4;
+	// 120 units per wheel notch, about 20% per notch
+	double zoom = std::clamp( view.m11() * std::pow( 1.0015, event->angleDelta().y() ), 1.0, maxZoom );
+	double factor = zoom / view.m11();
+	QPointF p = event->position();
+	view *= QTransform::fromTranslate( -p.x(), -p.y() ) * QTransform::fromScale( factor, factor ) * QTransform::fromTranslate( p.x(), p.y() );
+	if ( zoom == 1 ) {
+		view.reset();
+	}
+	event->accept();
+	viewChanged();
+}
 
-	double graphAR = graph->getWidth() / graph->getHeight();
-	double widgetWidth = width(), widgetHeight = height(), widgetAR = widgetWidth / widgetHeight;
-	double newWidth = graphAR > widgetAR ? widgetWidth : widgetHeight * graphAR;
-	double newHeight = graphAR > widgetAR ? widgetWidth / graphAR : widgetHeight;
-	painter.setViewport( ( widgetWidth - newWidth ) / 2, ( widgetHeight - newHeight ) / 2, newWidth, newHeight );
-	painter.setWindow( 0, 0, graph->getWidth(), graph->getHeight() );
+void GraphRender::mousePressEvent( QMouseEvent *event )
+{
+	drag_start = event->position();
+}
 
-	graph->paint( &painter );
+void GraphRender::mouseMoveEvent( QMouseEvent *event )
+{
+	if ( !( event->buttons() & Qt::LeftButton ) ) {
+		return;
+	}
+	QPointF delta = event->position() - drag_start;
+	drag_start = event->position();
+	view *= QTransform::fromTranslate( delta.x(), delta.y() );
+	viewChanged();
+}
+
+void GraphRender::mouseDoubleClickEvent( QMouseEvent * )
+{
+	view.reset();
+	viewChanged();
 }
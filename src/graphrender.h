@@ -1,16 +1,40 @@
 #pragma once
 #include "graph.h"
+#include <QPixmap>
+#include <QTransform>
 #include <QWidget>
+#include <memory>
 
+struct RenderCache;
+
+// Draws the graph from a render cache that is rebuilt once per graph change. The wheel zooms around the cursor,
+// dragging pans and a double click resets the view.
 class GraphRender : public QWidget
 {
 	Q_OBJECT
+public:
+	GraphRender();
+	~GraphRender() override;
 public slots:
-	void onGraphChanged( Graph * );
+	void onGraphChanged( std::shared_ptr<Graph> );
 
 protected:
 	void paintEvent( QPaintEvent *event ) override;
+	void wheelEvent( QWheelEvent *event ) override;
+	void mousePressEvent( QMouseEvent *event ) override;
+	void mouseMoveEvent( QMouseEvent *event ) override;
+	void mouseDoubleClickEvent( QMouseEvent *event ) override;
 
 private:
-	Graph *graph = nullptr;
-};
\ No newline at end of file
+	std::shared_ptr<Graph> graph;
+	int listener = -1;
+	std::unique_ptr<RenderCache> cache;
+	// Zoom and pan in widget pixels, applied after the transform that fits the graph into the widget
+	QTransform view;
+	QPointF drag_start;
+	// The last frame, shown again as long as neither the graph, the view nor the widget size changed
+	QPixmap frame;
+	bool frame_valid = false;
+	QTransform worldTransform() const;
+	void viewChanged();
+};
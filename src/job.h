@@ -0,0 +1,39 @@
+#pragma once
+#include <atomic>
+#include <functional>
+
+// Progress reporting and cooperative cancellation of a long computation. The computation polls cancelled() at safe
+// points and returns early once it is set, leaving its output incomplete; any thread may call cancel().
+// Progress is only reported from the thread that started the computation.
+class JobControl
+{
+public:
+	// stage names the step that is running, fraction is how much of it is done, in [0, 1]
+	using Progress = std::function<void( const char *stage, double fraction )>;
+
+	explicit JobControl( Progress progress = {} ) : progress( std::move( progress ) ) {}
+	void cancel() { cancel_requested.store( true, std::memory_order_relaxed ); }
+	bool cancelled() const { return cancel_requested.load( std::memory_order_relaxed ); }
+	void report( const char *stage, double fraction ) const
+	{
+		if ( progress ) {
+			progress( stage, fraction );
+		}
+	}
+
+private:
+	Progress progress;
+	std::atomic<bool> cancel_requested{ false };
+};
+
+// Helpers for the optional control of the option structs
+inline bool jobCancelled( const JobControl *control )
+{
+	return control != nullptr && control->cancelled();
+}
+inline void reportProgress( const JobControl *control, const char *stage, double fraction )
+{
+	if ( control != nullptr ) {
+		control->report( stage, fraction );
+	}
+}
@@ -0,0 +1,206 @@
+#include "layout.h"
+#include <cassert>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+	constexpr size_t sectionSize[] = { sizeof( LayoutSegment ), sizeof( LayoutSegment ), sizeof( LayoutSegment ), sizeof( LayoutPoint ), sizeof( uint64_t ) };
+
+	TwoPoints toTwoPoints( const LayoutSegment &s )
+	{
+		return { { s.p1.x, s.p1.y }, { s.p2.x, s.p2.y } };
+	}
+} // namespace
+
+MappedLayout::~MappedLayout()
+{
+	close();
+}
+bool MappedLayout::open( const char *path )
+{
+	close();
+	int fd = ::open( path, O_RDONLY );
+	if ( fd < 0 ) {
+		return false;
+	}
+	struct stat st;
+	if ( fstat( fd, &st ) != 0 || static_cast<size_t>( st.st_size ) < sizeof( LayoutHeader ) ) {
+		::close( fd );
+		return false;
+	}
+	void *mapping = mmap( nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0 );
+	::close( fd );
+	if ( mapping == MAP_FAILED ) {
+		return false;
+	}
+	data = static_cast<const char *>( mapping );
+	header = reinterpret_cast<const LayoutHeader *>( data );
+	size = st.st_size;
+
+	bool valid = !std::memcmp( header->magic, LayoutHeader::magicValue, sizeof( header->magic ) ) && header->version == LayoutHeader::currentVersion &&
+				 header->sectionCount == static_cast<uint32_t>( LayoutSection::Count ) && header->width > 0 && header->height > 0;
+	for ( size_t s = 0; valid && s < static_cast<size_t>( LayoutSection::Count ); ++s ) {
+		auto [offset, count] = header->sections[s];
+		valid = offset % 8 == 0 && offset <= size && count <= ( size - offset ) / sectionSize[s];
+	}
+	if ( valid ) {
+		// Route offsets must start at 0 and end at the point count, the ones in between are checked by toGraph()
+		auto offsets = section<uint64_t>( LayoutSection::RouteOffsets );
+		size_t routeOffsets = count( LayoutSection::RouteOffsets );
+		valid = routeOffsets >= 1 && offsets[0] == 0 && offsets[routeOffsets - 1] == count( LayoutSection::RoutePoints );
+	}
+	if ( !valid ) {
+		close();
+	}
+	return valid;
+}
+void MappedLayout::close()
+{
+	if ( data ) {
+		munmap( const_cast<char *>( data ), size );
+	}
+	data = nullptr;
+	header = nullptr;
+	size = 0;
+}
+Graph *MappedLayout::toGraph() const
+{
+	assert( header );
+	std::vector<TwoPoints> obstacles, nets, cdt_edges;
+	obstacles.reserve( obstacleCount() );
+	for ( size_t i = 0; i < obstacleCount(); ++i ) {
+		obstacles.push_back( toTwoPoints( this->obstacles()[i] ) );
+	}
+	nets.reserve( netCount() );
+	for ( size_t i = 0; i < netCount(); ++i ) {
+		nets.push_back( toTwoPoints( this->nets()[i] ) );
+	}
+	cdt_edges.reserve( cdtEdgeCount() );
+	for ( size_t i = 0; i < cdtEdgeCount(); ++i ) {
+		cdt_edges.push_back( toTwoPoints( cdtEdges()[i] ) );
+	}
+	auto graph = new Graph( width(), height(), std::move( obstacles ), std::move( nets ) );
+	graph->setCdtEdges( std::move( cdt_edges ) );
+	// Routes beyond the nets, or with offsets out of order, cannot come from saveGraph
+	for ( size_t i = 0; i < routeCount() && i < netCount(); ++i ) {
+		if ( routeEnd( i ) < routeBegin( i ) || routeEnd( i ) > routeEnd( routeCount() - 1 ) ) {
+			break;
+		}
+		std::vector<Point> route;
+		route.reserve( routeEnd( i ) - routeBegin( i ) );
+		for ( auto p = routeBegin( i ); p != routeEnd( i ); ++p ) {
+			route.emplace_back( p->x, p->y );
+		}
+		graph->setRoute( i, std::move( route ) );
+	}
+	return graph;
+}
+
+LayoutWriter::LayoutWriter( const char *path, double width, double height ) : file( std::fopen( path, "wb" ) )
+{
+	std::memcpy( header.magic, LayoutHeader::magicValue, sizeof( header.magic ) );
+	header.version = LayoutHeader::currentVersion;
+	header.sectionCount = static_cast<uint32_t>( LayoutSection::Count );
+	header.width = width;
+	header.height = height;
+	// The header is rewritten by finish(), sections start right after it
+	write( &header, sizeof( header ) );
+	header.sections[0].offset = position;
+}
+LayoutWriter::~LayoutWriter()
+{
+	finish();
+}
+void LayoutWriter::addObstacle( const TwoPoints &obstacle )
+{
+	addSegment( LayoutSection::Obstacles, obstacle );
+}
+void LayoutWriter::addNet( const TwoPoints &net )
+{
+	addSegment( LayoutSection::Nets, net );
+}
+void LayoutWriter::addCdtEdge( const TwoPoints &edge )
+{
+	addSegment( LayoutSection::CdtEdges, edge );
+}
+void LayoutWriter::addRoute( const std::vector<Point> &route )
+{
+	enter( LayoutSection::RoutePoints );
+	for ( auto [x, y] : route ) {
+		LayoutPoint p{ x, y };
+		write( &p, sizeof( p ) );
+	}
+	header.sections[static_cast<size_t>( LayoutSection::RoutePoints )].count += route.size();
+	route_offsets.push_back( route_offsets.back() + route.size() );
+}
+bool LayoutWriter::finish()
+{
+	if ( !file ) {
+		return false;
+	}
+	enter( LayoutSection::RouteOffsets );
+	write( route_offsets.data(), route_offsets.size() * sizeof( uint64_t ) );
+	header.sections[static_cast<size_t>( LayoutSection::RouteOffsets )].count = route_offsets.size();
+	if ( std::fseek( file, 0, SEEK_SET ) != 0 ) {
+		failed = true;
+	}
+	write( &header, sizeof( header ) );
+	bool result = ok();
+	failed = std::fclose( file ) != 0 || failed;
+	file = nullptr;
+	return result && !failed;
+}
+// Close the sections before s, every section starts where the previous one ended
+void LayoutWriter::enter( LayoutSection s )
+{
+	assert( s >= current );
+	while ( current < s ) {
+		current = static_cast<LayoutSection>( static_cast<uint32_t>( current ) + 1 );
+		header.sections[static_cast<size_t>( current )].offset = position;
+	}
+}
+void LayoutWriter::addSegment( LayoutSection s, const TwoPoints &segment )
+{
+	enter( s );
+	auto [p1, p2] = segment;
+	LayoutSegment record{ { std::get<0>( p1 ), std::get<1>( p1 ) }, { std::get<0>( p2 ), std::get<1>( p2 ) } };
+	write( &record, sizeof( record ) );
+	++header.sections[static_cast<size_t>( s )].count;
+}
+void LayoutWriter::write( const void *bytes, size_t length )
+{
+	if ( file && std::fwrite( bytes, 1, length, file ) != length ) {
+		failed = true;
+	}
+	position += length;
+}
+
+bool saveGraph( const Graph &graph, const char *path )
+{
+	LayoutWriter writer( path, graph.getWidth(), graph.getHeight() );
+	for ( const auto &obstacle : graph.getObstacles() ) {
+		writer.addObstacle( obstacle );
+	}
+	for ( const auto &net : graph.getNets() ) {
+		writer.addNet( net );
+	}
+	for ( const auto &edge : graph.getCdtEdges() ) {
+		writer.addCdtEdge( edge );
+	}
+	for ( const auto &route : graph.getRoutes() ) {
+		writer.addRoute( route );
+	}
+	return writer.finish();
+}
+Graph *loadGraph( const char *path )
+{
+	MappedLayout layout;
+	if ( !layout.open( path ) ) {
+		return nullptr;
+	}
+	return layout.toGraph();
+}
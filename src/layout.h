@@ -0,0 +1,124 @@
+#pragma once
+#include "graph.h"
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+// Binary layout files.
+// A file is a LayoutHeader followed by the sections it points at. Every value is little-endian and every section is
+// 8-byte aligned, so after mmap the arrays are used in place. Obstacles, nets and CDT edges are LayoutSegment
+// arrays; routes are one LayoutPoint array cut by routeCount + 1 offsets.
+// Version 1 is the only version so far, readers reject any other.
+static_assert( __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__, "layout files are mapped in place, which needs a little-endian host" );
+
+struct LayoutPoint {
+	double x, y;
+};
+// Obstacle corners (x1, y1) and (x2, y2), net pins or CDT edge ends
+struct LayoutSegment {
+	LayoutPoint p1, p2;
+};
+static_assert( sizeof( LayoutSegment ) == 32, "layout records are part of the file format" );
+
+enum class LayoutSection : uint32_t
+{
+	Obstacles,
+	Nets,
+	CdtEdges,
+	RoutePoints,
+	RouteOffsets,
+	Count
+};
+
+struct LayoutHeader {
+	static constexpr char magicValue[8] = "AARFLAY";
+	static constexpr uint32_t currentVersion = 1;
+
+	char magic[8];
+	uint32_t version;
+	uint32_t sectionCount;
+	double width, height;
+	// Byte offset and element count of every section
+	struct {
+		uint64_t offset, count;
+	} sections[static_cast<size_t>( LayoutSection::Count )];
+};
+static_assert( sizeof( LayoutHeader ) == 112, "the header is part of the file format" );
+
+// Read-only view of a layout file mapped into memory. The arrays point straight into the mapping, so opening a
+// file costs page faults on first touch rather than parsing.
+class MappedLayout
+{
+public:
+	MappedLayout() = default;
+	MappedLayout( const MappedLayout & ) = delete;
+	MappedLayout &operator=( const MappedLayout & ) = delete;
+	~MappedLayout();
+	// False if the file cannot be mapped or is not a valid layout of a known version
+	bool open( const char *path );
+	void close();
+
+	double width() const { return header->width; }
+	double height() const { return header->height; }
+	const LayoutSegment *obstacles() const { return section<LayoutSegment>( LayoutSection::Obstacles ); }
+	size_t obstacleCount() const { return count( LayoutSection::Obstacles ); }
+	const LayoutSegment *nets() const { return section<LayoutSegment>( LayoutSection::Nets ); }
+	size_t netCount() const { return count( LayoutSection::Nets ); }
+	const LayoutSegment *cdtEdges() const { return section<LayoutSegment>( LayoutSection::CdtEdges ); }
+	size_t cdtEdgeCount() const { return count( LayoutSection::CdtEdges ); }
+	size_t routeCount() const { return count( LayoutSection::RouteOffsets ) - 1; }
+	// Points of route i are [routeBegin( i ), routeEnd( i ))
+	const LayoutPoint *routeBegin( size_t i ) const { return section<LayoutPoint>( LayoutSection::RoutePoints ) + section<uint64_t>( LayoutSection::RouteOffsets )[i]; }
+	const LayoutPoint *routeEnd( size_t i ) const { return section<LayoutPoint>( LayoutSection::RoutePoints ) + section<uint64_t>( LayoutSection::RouteOffsets )[i + 1]; }
+
+	// Copy into a Graph, one sequential pass over every array
+	Graph *toGraph() const;
+
+private:
+	template<typename T>
+	const T *section( LayoutSection s ) const
+	{
+		return reinterpret_cast<const T *>( data + header->sections[static_cast<size_t>( s )].offset );
+	}
+	size_t count( LayoutSection s ) const { return header->sections[static_cast<size_t>( s )].count; }
+
+	const char *data = nullptr;
+	const LayoutHeader *header = nullptr;
+	size_t size = 0;
+};
+
+// Writes a layout file front to back without holding it in memory. Sections are optional but go in order:
+// obstacles, nets, CDT edges, then routes. finish(), also called by the destructor, fills in the header.
+class LayoutWriter
+{
+public:
+	LayoutWriter( const char *path, double width, double height );
+	LayoutWriter( const LayoutWriter & ) = delete;
+	LayoutWriter &operator=( const LayoutWriter & ) = delete;
+	~LayoutWriter();
+	// False once opening or writing the file failed
+	bool ok() const { return file && !failed; }
+	void addObstacle( const TwoPoints &obstacle );
+	void addNet( const TwoPoints &net );
+	void addCdtEdge( const TwoPoints &edge );
+	void addRoute( const std::vector<Point> &route );
+	bool finish();
+
+private:
+	void enter( LayoutSection s );
+	void addSegment( LayoutSection s, const TwoPoints &segment );
+	void write( const void *bytes, size_t length );
+
+	std::FILE *file;
+	bool failed = false;
+	LayoutHeader header{};
+	LayoutSection current = LayoutSection::Obstacles;
+	uint64_t position = 0;
+	// Start of every route in the point section, written last
+	std::vector<uint64_t> route_offsets{ 0 };
+};
+
+bool saveGraph( const Graph &graph, const char *path );
+// nullptr if the file cannot be read
+Graph *loadGraph( const char *path );
@@ -0,0 +1,96 @@
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cmath>
+#include <vector>
+
+// Jump-and-walk index for point location.
+// A uniform grid over the triangulated area remembers one recently added vertex per cell. A query jumps to the
+// vertex stored in its cell (or the nearest non-empty cell) and the caller walks the mesh from there, so the walk
+// length stays O(1) expected for well distributed vertices and is independent of insertion order.
+template<typename Index>
+class BasicPointLocator
+{
+public:
+	static constexpr Index none = ~Index( 0 );
+
+	// Size the grid for about `expected` vertices inside [minX, maxX] x [minY, maxY]
+	void reset( double minX, double minY, double maxX, double maxY, size_t expected )
+	{
+		originX = minX, originY = minY;
+		double w = std::max( maxX - minX, 1e-12 ), h = std::max( maxY - minY, 1e-12 );
+		// About two vertices per cell
+		double cellCount = std::max( 1.0, expected / 2.0 );
+		cellSize = std::sqrt( w * h / cellCount );
+		columns = std::max( 1, static_cast<int>( std::ceil( w / cellSize ) ) );
+		rows = std::max( 1, static_cast<int>( std::ceil( h / cellSize ) ) );
+		cells.assign( static_cast<size_t>( columns ) * rows, none );
+		count = 0;
+	}
+	void add( Index vertex, double x, double y )
+	{
+		cells[cellOf( x, y )] = vertex;
+		last = vertex;
+		++count;
+	}
+	// Forget a vertex that left the mesh, its cell stays empty until another vertex lands there
+	void remove( Index vertex, double x, double y )
+	{
+		if ( count > 0 ) {
+			--count;
+		}
+		auto &cell = cells[cellOf( x, y )];
+		if ( cell == vertex ) {
+			cell = none;
+		}
+		if ( last == vertex ) {
+			last = none;
+		}
+	}
+	// A vertex close to (x, y), or none when nothing was added
+	Index hint( double x, double y ) const
+	{
+		if ( count == 0 ) {
+			return none;
+		}
+		int cx, cy;
+		cellCoords( x, y, cx, cy );
+		// Search rings of cells around the query, the grid is dense so this almost always stops at radius 0
+		int maxRadius = std::max( columns, rows );
+		for ( int r = 0; r <= maxRadius && r <= 4; ++r ) {
+			for ( int j = cy - r; j <= cy + r; ++j ) {
+				for ( int i = cx - r; i <= cx + r; ++i ) {
+					if ( std::max( std::abs( i - cx ), std::abs( j - cy ) ) != r || i < 0 || j < 0 || i >= columns || j >= rows ) {
+						continue;
+					}
+					auto vertex = cells[static_cast<size_t>( j ) * columns + i];
+					if ( vertex != none ) {
+						return vertex;
+					}
+				}
+			}
+		}
+		return last;
+	}
+
+private:
+	void cellCoords( double x, double y, int &cx, int &cy ) const
+	{
+		cx = static_cast<int>( std::clamp( ( x - originX ) / cellSize, 0.0, columns - 1.0 ) );
+		cy = static_cast<int>( std::clamp( ( y - originY ) / cellSize, 0.0, rows - 1.0 ) );
+	}
+	size_t cellOf( double x, double y ) const
+	{
+		int cx, cy;
+		cellCoords( x, y, cx, cy );
+		return static_cast<size_t>( cy ) * columns + cx;
+	}
+
+	double originX = 0, originY = 0, cellSize = 1;
+	int columns = 1, rows = 1;
+	std::vector<Index> cells;
+	Index last = none;
+	size_t count = 0;
+};
+
+using PointLocator = BasicPointLocator<uint32_t>;
@@ -0,0 +1,164 @@
+#pragma once
+#include <cassert>
+#include <cstdint>
+#include <tuple>
+#include <vector>
+
+// Triangle mesh storage for CDTHelper.
+// Triangle t has vertices v[0..2] in counter-clockwise order. Edge i runs from v[i] to v[(i + 1) % 3],
+// adj[i] is the triangle across edge i and adjEdge[i] is the index of the same edge inside adj[i].
+// Triangle 0 is a sentinel meaning "outside", so every real index is non-zero.
+// Bits 0-2 of flags mark constrained edges, bit 3 marks triangles inside an obstacle.
+// Index is the type of vertex and triangle indices: 32 bits keep a record at half a cache line, 64 bits are for
+// meshes beyond 2^32 vertices.
+template<typename Index>
+struct alignas( 16 ) TriangleRecord {
+	Index v[3];
+	Index adj[3];
+	uint8_t adjEdge[3];
+	uint8_t flags;
+};
+static_assert( sizeof( TriangleRecord<uint32_t> ) == 32, "triangle records must stay two per cache line" );
+static_assert( sizeof( TriangleRecord<uint64_t> ) == 64, "wide triangle records must stay one per cache line" );
+
+template<typename Index>
+class BasicTriangleMesh
+{
+public:
+	using Record = TriangleRecord<Index>;
+
+	explicit BasicTriangleMesh( size_t capacity = 0 ) : records( 1 )
+	{
+		records.reserve( capacity + 1 );
+	}
+	Index &vertex( Index t, unsigned i ) { return records[t].v[i]; }
+	Index vertex( Index t, unsigned i ) const { return records[t].v[i]; }
+	Index &adjacent( Index t, unsigned i ) { return records[t].adj[i]; }
+	Index adjacent( Index t, unsigned i ) const { return records[t].adj[i]; }
+	unsigned adjacentEdge( Index t, unsigned i ) const { return records[t].adjEdge[i]; }
+	const Record &operator[]( Index t ) const { return records[t]; }
+	bool isConstrained( Index t, unsigned i ) const { return records[t].flags & ( 1u << i ); }
+	bool isHole( Index t ) const { return records[t].flags & holeFlag; }
+	void setHole( Index t, bool hole )
+	{
+		records[t].flags = hole ? records[t].flags | holeFlag : records[t].flags & ~holeFlag;
+	}
+	// Some triangle having p as a vertex
+	Index vertexTriangle( Index p ) const { return vertex_triangle[p]; }
+
+	// Index of the last triangle, which is also the number of triangles
+	Index last() const { return records.size() - 1; }
+
+	// Append a triangle without neighbours, they are set with link()
+	Index push( Index p0, Index p1, Index p2 )
+	{
+		records.push_back( { { p0, p1, p2 }, { 0, 0, 0 }, { 0, 0, 0 }, 0 } );
+		touch( last() );
+		return last();
+	}
+	// Make edge i of t and edge j of u neighbours, u may be the outside sentinel
+	void link( Index t, unsigned i, Index u, unsigned j, bool constrained = false )
+	{
+		records[t].adj[i] = u;
+		records[t].adjEdge[i] = j;
+		setEdgeFlag( t, i, constrained );
+		if ( u != 0 ) {
+			records[u].adj[j] = t;
+			records[u].adjEdge[j] = i;
+			setEdgeFlag( u, j, constrained );
+		}
+	}
+	void setConstrained( Index t, unsigned i, bool constrained )
+	{
+		link( t, i, records[t].adj[i], records[t].adjEdge[i], constrained );
+	}
+	// Point the vertex-to-triangle map of every vertex of t at t, needed after vertices are moved
+	void touch( Index t )
+	{
+		for ( Index p : records[t].v ) {
+			if ( p >= vertex_triangle.size() ) {
+				vertex_triangle.resize( p + 1, 0 );
+			}
+			vertex_triangle[p] = t;
+		}
+	}
+	// Position of vertex p inside triangle t
+	unsigned indexOf( Index t, Index p ) const
+	{
+		auto &r = records[t];
+		assert( r.v[0] == p || r.v[1] == p || r.v[2] == p );
+		return r.v[0] == p ? 0 : r.v[1] == p ? 1 : 2;
+	}
+	// Make room for triangles 1..count written with set(), so separate threads can fill disjoint ranges.
+	// Vertex indices must stay below vertexCount.
+	void resize( size_t count, size_t vertexCount )
+	{
+		records.resize( count + 1 );
+		vertex_triangle.resize( vertexCount, 0 );
+	}
+	// Overwrite triangle t with a triangle without neighbours
+	void set( Index t, Index p0, Index p1, Index p2 )
+	{
+		records[t] = { { p0, p1, p2 }, { 0, 0, 0 }, { 0, 0, 0 }, 0 };
+		touch( t );
+	}
+	// Keep only the triangles of the given [begin, end) ranges, packed in order.
+	// Neighbours must lie inside the same range or be the outside sentinel.
+	void compact( const std::vector<std::tuple<Index, Index>> &ranges )
+	{
+		Index out = 1;
+		for ( auto [begin, end] : ranges ) {
+			Index shift = begin - out;
+			for ( Index t = begin; t < end; ++t, ++out ) {
+				records[out] = records[t];
+				for ( auto &u : records[out].adj ) {
+					u = u != 0 ? u - shift : 0;
+				}
+			}
+		}
+		records.resize( out );
+		for ( Index t = 1; t < out; ++t ) {
+			touch( t );
+		}
+	}
+	// Drop triangle t, which nothing may point at any more, by moving the last triangle into its slot
+	void remove( Index t )
+	{
+		Index moved = last();
+		if ( t != moved ) {
+			records[t] = records[moved];
+			for ( unsigned i = 0; i < 3; i++ ) {
+				if ( records[t].adj[i] != 0 ) {
+					records[records[t].adj[i]].adj[records[t].adjEdge[i]] = t;
+				}
+			}
+			touch( t );
+		}
+		records.pop_back();
+	}
+	void clear()
+	{
+		records.resize( 1 );
+		vertex_triangle.clear();
+	}
+	void reserve( size_t capacity )
+	{
+		records.reserve( capacity + 1 );
+	}
+	size_t capacityBytes() const
+	{
+		return records.capacity() * sizeof( Record ) + vertex_triangle.capacity() * sizeof( Index );
+	}
+
+private:
+	static constexpr uint8_t holeFlag = 1u << 3;
+	void setEdgeFlag( Index t, unsigned i, bool constrained )
+	{
+		records[t].flags = constrained ? records[t].flags | ( 1u << i ) : records[t].flags & ~( 1u << i );
+	}
+
+	std::vector<Record> records;
+	std::vector<Index> vertex_triangle;
+};
+
+using TriangleMesh = BasicTriangleMesh<uint32_t>;
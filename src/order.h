@@ -0,0 +1,115 @@
+#pragma once
+#include "profile.h"
+#include "util.h"
+#include <array>
+#include <cstdint>
+#include <vector>
+
+// Building blocks for the insertion order of the Delaunay build: space-filling curve keys and a stable radix sort
+// that orders nodes by them in linear time.
+
+// Spread the low 16 bits of x to the even bit positions
+inline uint32_t interleaveBits( uint32_t x )
+{
+	x = ( x | ( x << 8 ) ) & 0x00FF00FF;
+	x = ( x | ( x << 4 ) ) & 0x0F0F0F0F;
+	x = ( x | ( x << 2 ) ) & 0x33333333;
+	return ( x | ( x << 1 ) ) & 0x55555555;
+}
+
+// Index of cell (x, y) along the Hilbert curve over a 2^16 x 2^16 grid. Instead of descending one quadrant per
+// level, the orientation of every level is found with a parallel prefix scan over all 16 bits at once.
+inline uint32_t hilbertIndex( uint32_t x, uint32_t y )
+{
+	uint32_t A, B, C, D;
+	{
+		uint32_t a = x ^ y, b = 0xFFFF ^ a, c = 0xFFFF ^ ( x | y ), d = x & ( y ^ 0xFFFF );
+		A = a | ( b >> 1 );
+		B = ( a >> 1 ) ^ a;
+		C = ( ( c >> 1 ) ^ ( b & ( d >> 1 ) ) ) ^ c;
+		D = ( ( a & ( c >> 1 ) ) ^ ( d >> 1 ) ) ^ d;
+	}
+	for ( unsigned shift = 2; shift <= 8; shift *= 2 ) {
+		uint32_t a = A, b = B, c = C, d = D;
+		A = ( a & ( a >> shift ) ) ^ ( b & ( b >> shift ) );
+		B = ( a & ( b >> shift ) ) ^ ( b & ( ( a ^ b ) >> shift ) );
+		C ^= ( a & ( c >> shift ) ) ^ ( b & ( d >> shift ) );
+		D ^= ( b & ( c >> shift ) ) ^ ( ( a ^ b ) & ( d >> shift ) );
+	}
+	uint32_t a = C ^ ( C >> 1 ), b = D ^ ( D >> 1 );
+	uint32_t i0 = x ^ y, i1 = b | ( 0xFFFF ^ ( i0 | a ) );
+	return ( interleaveBits( i1 ) << 1 ) | interleaveBits( i0 );
+}
+
+// The value is as wide as the key, which costs nothing against the padding and carries 64-bit node indices
+struct RadixItem {
+	uint64_t key;
+	uint64_t value;
+};
+
+// Stable LSD radix sort of items by key, keys below 2^bits, 8 bits per pass. scratch is resized to match, so
+// callers can keep both buffers between sorts. Each pass cuts the items into `threads` chunks that are counted
+// and scattered concurrently; passes where every key has the same digit are skipped.
+inline void radixSortItems( std::vector<RadixItem> &items, std::vector<RadixItem> &scratch, unsigned bits, unsigned threads )
+{
+	constexpr unsigned digitBits = 8, radix = 1 << digitBits;
+	size_t count = items.size();
+	threads = std::max<size_t>( 1, std::min<size_t>( threads, count / radix ) );
+	scratch.resize( count );
+	std::vector<std::array<size_t, radix>> offsets( threads );
+	for ( unsigned shift = 0; shift < bits; shift += digitBits ) {
+		auto digit = [&]( const RadixItem &item ) { return static_cast<unsigned>( item.key >> shift ) & ( radix - 1 ); };
+		parallelFor( threads, threads, [&]( size_t begin, size_t end ) {
+			for ( size_t c = begin; c < end; ++c ) {
+				offsets[c].fill( 0 );
+				for ( size_t i = count * c / threads; i < count * ( c + 1 ) / threads; ++i ) {
+					++offsets[c][digit( items[i] )];
+				}
+			}
+		} );
+		// Exclusive prefix sum, digit major and chunk minor, which keeps equal digits in chunk order
+		size_t sum = 0;
+		bool single = false;
+		for ( unsigned d = 0; d < radix; ++d ) {
+			size_t before = sum;
+			for ( unsigned c = 0; c < threads; ++c ) {
+				size_t n = offsets[c][d];
+				offsets[c][d] = sum;
+				sum += n;
+			}
+			single = single || sum - before == count;
+		}
+		if ( single ) {
+			continue;
+		}
+		countEvent( Counter::RadixPasses );
+		parallelFor( threads, threads, [&]( size_t begin, size_t end ) {
+			for ( size_t c = begin; c < end; ++c ) {
+				for ( size_t i = count * c / threads; i < count * ( c + 1 ) / threads; ++i ) {
+					scratch[offsets[c][digit( items[i] )]++] = items[i];
+				}
+			}
+		} );
+		items.swap( scratch );
+	}
+}
+
+// Stable sort of order by keys[order[i]], which are non-negative and below 2^bits. Keys travel with the nodes
+// in items, so every pass streams through memory.
+template<typename Key, typename Index>
+void radixSort( std::vector<Index> &order, const Key *keys, unsigned bits, unsigned threads, std::vector<RadixItem> &items, std::vector<RadixItem> &scratch )
+{
+	size_t count = order.size();
+	items.resize( count );
+	parallelFor( threads, count, [&]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			items[i] = { static_cast<uint64_t>( keys[order[i]] ), order[i] };
+		}
+	} );
+	radixSortItems( items, scratch, bits, threads );
+	parallelFor( threads, count, [&]( size_t begin, size_t end ) {
+		for ( size_t i = begin; i < end; ++i ) {
+			order[i] = items[i].value;
+		}
+	} );
+}
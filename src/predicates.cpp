@@ -0,0 +1,188 @@
+#include "predicates.h"
+#include <cmath>
+#include <vector>
+
+// Exact arithmetic on floating point expansions, see Shewchuk, "Adaptive Precision Floating-Point
+// Arithmetic and Fast Robust Geometric Predicates". An expansion is a sum of non-overlapping doubles
+// stored in increasing order of magnitude.
+
+namespace
+{
+	using Expansion = std::vector<double>;
+
+	constexpr double epsilon = 1.1102230246251565e-16; // 2^-53
+	constexpr double orientErrBound = ( 3.0 + 16.0 * epsilon ) * epsilon;
+	constexpr double incircleErrBound = ( 10.0 + 96.0 * epsilon ) * epsilon;
+
+	inline void twoSum( double a, double b, double &x, double &y )
+	{
+		x = a + b;
+		double bv = x - a, av = x - bv;
+		y = ( a - av ) + ( b - bv );
+	}
+	inline void twoProduct( double a, double b, double &x, double &y )
+	{
+		x = a * b;
+		y = std::fma( a, b, -x );
+	}
+
+	// Exact a - b as a two-component expansion
+	Expansion difference( double a, double b )
+	{
+		double x, y;
+		twoSum( a, -b, x, y );
+		return { y, x };
+	}
+	// e + b
+	Expansion grow( const Expansion &e, double b )
+	{
+		Expansion h;
+		h.reserve( e.size() + 1 );
+		double q = b;
+		for ( double component : e ) {
+			double sum, err;
+			twoSum( q, component, sum, err );
+			if ( err != 0 ) {
+				h.push_back( err );
+			}
+			q = sum;
+		}
+		if ( q != 0 || h.empty() ) {
+			h.push_back( q );
+		}
+		return h;
+	}
+	// e + f
+	Expansion sum( const Expansion &e, const Expansion &f )
+	{
+		Expansion h = e;
+		for ( double component : f ) {
+			h = grow( h, component );
+		}
+		return h;
+	}
+	// e * b
+	Expansion scale( const Expansion &e, double b )
+	{
+		Expansion h;
+		h.reserve( 2 * e.size() );
+		double q = 0;
+		for ( size_t i = 0; i < e.size(); ++i ) {
+			double product, productErr;
+			twoProduct( e[i], b, product, productErr );
+			if ( i == 0 ) {
+				if ( productErr != 0 ) {
+					h.push_back( productErr );
+				}
+				q = product;
+				continue;
+			}
+			double s, err;
+			twoSum( q, productErr, s, err );
+			if ( err != 0 ) {
+				h.push_back( err );
+			}
+			twoSum( product, s, q, err );
+			if ( err != 0 ) {
+				h.push_back( err );
+			}
+		}
+		if ( q != 0 || h.empty() ) {
+			h.push_back( q );
+		}
+		return h;
+	}
+	// e * f
+	Expansion product( const Expansion &e, const Expansion &f )
+	{
+		Expansion h{ 0 };
+		for ( double component : f ) {
+			h = sum( h, scale( e, component ) );
+		}
+		return h;
+	}
+	Expansion negate( Expansion e )
+	{
+		for ( double &component : e ) {
+			component = -component;
+		}
+		return e;
+	}
+	// The most significant non-zero component carries the sign of the whole expansion
+	double sign( const Expansion &e )
+	{
+		for ( auto it = e.rbegin(); it != e.rend(); ++it ) {
+			if ( *it != 0 ) {
+				return *it;
+			}
+		}
+		return 0;
+	}
+
+	double orient2dExact( double ax, double ay, double bx, double by, double cx, double cy )
+	{
+		auto acx = difference( ax, cx ), acy = difference( ay, cy ), bcx = difference( bx, cx ), bcy = difference( by, cy );
+		return sign( sum( product( acx, bcy ), negate( product( acy, bcx ) ) ) );
+	}
+
+	double incircleExact( double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy )
+	{
+		auto adx = difference( ax, dx ), ady = difference( ay, dy );
+		auto bdx = difference( bx, dx ), bdy = difference( by, dy );
+		auto cdx = difference( cx, dx ), cdy = difference( cy, dy );
+		auto alift = sum( product( adx, adx ), product( ady, ady ) );
+		auto blift = sum( product( bdx, bdx ), product( bdy, bdy ) );
+		auto clift = sum( product( cdx, cdx ), product( cdy, cdy ) );
+		auto bc = sum( product( bdx, cdy ), negate( product( cdx, bdy ) ) );
+		auto ca = sum( product( cdx, ady ), negate( product( adx, cdy ) ) );
+		auto ab = sum( product( adx, bdy ), negate( product( bdx, ady ) ) );
+		return sign( sum( sum( product( alift, bc ), product( blift, ca ) ), product( clift, ab ) ) );
+	}
+} // namespace
+
+double orient2d( double ax, double ay, double bx, double by, double cx, double cy )
+{
+	double detLeft = ( ax - cx ) * ( by - cy );
+	double detRight = ( ay - cy ) * ( bx - cx );
+	double det = detLeft - detRight;
+	double detSum;
+	if ( detLeft > 0 ) {
+		if ( detRight <= 0 ) {
+			return det;
+		}
+		detSum = detLeft + detRight;
+	} else if ( detLeft < 0 ) {
+		if ( detRight >= 0 ) {
+			return det;
+		}
+		detSum = -detLeft - detRight;
+	} else {
+		return det;
+	}
+	double errBound = orientErrBound * detSum;
+	if ( det >= errBound || -det >= errBound ) {
+		return det;
+	}
+	return orient2dExact( ax, ay, bx, by, cx, cy );
+}
+
+double incircle( double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy )
+{
+	double adx = ax - dx, bdx = bx - dx, cdx = cx - dx;
+	double ady = ay - dy, bdy = by - dy, cdy = cy - dy;
+
+	double bdxcdy = bdx * cdy, cdxbdy = cdx * bdy;
+	double alift = adx * adx + ady * ady;
+	double cdxady = cdx * ady, adxcdy = adx * cdy;
+	double blift = bdx * bdx + bdy * bdy;
+	double adxbdy = adx * bdy, bdxady = bdx * ady;
+	double clift = cdx * cdx + cdy * cdy;
+
+	double det = alift * ( bdxcdy - cdxbdy ) + blift * ( cdxady - adxcdy ) + clift * ( adxbdy - bdxady );
+	double permanent = ( std::fabs( bdxcdy ) + std::fabs( cdxbdy ) ) * alift + ( std::fabs( cdxady ) + std::fabs( adxcdy ) ) * blift + ( std::fabs( adxbdy ) + std::fabs( bdxady ) ) * clift;
+	double errBound = incircleErrBound * permanent;
+	if ( det > errBound || -det > errBound ) {
+		return det;
+	}
+	return incircleExact( ax, ay, bx, by, cx, cy, dx, dy );
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+// Robust geometric predicates.
+// Both predicates evaluate a floating point approximation first and only fall back to exact
+// expansion arithmetic when the result is smaller than its error bound, so the sign is always exact.
+
+// Positive if a, b, c are in counter-clockwise order, negative if clockwise, zero if collinear
+double orient2d( double ax, double ay, double bx, double by, double cx, double cy );
+
+// Positive if d lies inside the circle through the counter-clockwise triangle a, b, c,
+// negative if outside, zero if the four points are cocircular
+double incircle( double ax, double ay, double bx, double by, double cx, double cy, double dx, double dy );
@@ -0,0 +1,65 @@
+#include "profile.h"
+#include <algorithm>
+#include <iomanip>
+#include <ostream>
+
+const char *counterName( Counter counter )
+{
+	switch ( counter ) {
+		case Counter::Locates:
+			return "locates";
+		case Counter::WalkSteps:
+			return "walkSteps";
+		case Counter::TriangleSplits:
+			return "triangleSplits";
+		case Counter::EdgeSplits:
+			return "edgeSplits";
+		case Counter::Flips:
+			return "flips";
+		case Counter::ConstraintFlips:
+			return "constraintFlips";
+		case Counter::HullSteps:
+			return "hullSteps";
+		case Counter::ZipSteps:
+			return "zipSteps";
+		case Counter::RadixPasses:
+			return "radixPasses";
+		default:
+			return "unknown";
+	}
+}
+
+void writeChromeTrace( std::ostream &out, const std::vector<std::tuple<std::string, const Profile *>> &processes )
+{
+	// Timestamps are in microseconds, written to the nanosecond however long the run
+	auto flags = out.flags();
+	auto precision = out.precision();
+	out << std::fixed << std::setprecision( 3 );
+	out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+	const char *separator = "\n";
+	unsigned pid = 0;
+	for ( const auto &[name, profile] : processes ) {
+		++pid;
+		out << separator << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"args\": {\"name\": \"";
+		// Names are our own labels, only quotes and backslashes need escaping
+		for ( char c : name ) {
+			out << ( c == '"' || c == '\\' ? "\\" : "" ) << c;
+		}
+		out << "\"}}";
+		separator = ",\n";
+		double end = 0;
+		for ( const auto &span : profile->spans ) {
+			out << separator << "{\"name\": \"" << span.name << "\", \"ph\": \"X\", \"pid\": " << pid << ", \"tid\": " << span.thread << ", \"ts\": " << span.start * 1e6
+				<< ", \"dur\": " << span.seconds * 1e6 << "}";
+			end = std::max( end, span.start + span.seconds );
+		}
+		out << separator << "{\"name\": \"counters\", \"ph\": \"C\", \"pid\": " << pid << ", \"ts\": " << end * 1e6 << ", \"args\": {";
+		for ( size_t i = 0; i < profile->counters.size(); ++i ) {
+			out << ( i ? ", " : "" ) << "\"" << counterName( static_cast<Counter>( i ) ) << "\": " << profile->counters[i];
+		}
+		out << "}}";
+	}
+	out << "\n]}\n";
+	out.flags( flags );
+	out.precision( precision );
+}
@@ -0,0 +1,139 @@
+#pragma once
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <iosfwd>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Lightweight instrumentation: event counters bumped by the hot loops and timed spans of the coarse steps.
+// Counters are compiled in unless AARF_PROFILE is 0, spans are only recorded when a run is given a Profile.
+#ifndef AARF_PROFILE
+#define AARF_PROFILE 1
+#endif
+
+enum class Counter
+{
+	Locates,         // nodes located by a walk
+	WalkSteps,       // triangles visited by those walks
+	TriangleSplits,  // nodes inserted inside a triangle
+	EdgeSplits,      // nodes inserted on an edge
+	Flips,           // edge flips of every kind
+	ConstraintFlips, // flips removing edges that cross a constraint
+	HullSteps,       // hull vertices visited by the strip sweeps while finding and covering the visible chain
+	ZipSteps,        // tangent moves while zipping neighbouring strips
+	RadixPasses,     // radix sort passes run, skipped ones excluded
+	Count
+};
+
+const char *counterName( Counter counter );
+
+using CounterBlock = std::array<uint64_t, static_cast<size_t>( Counter::Count )>;
+
+// Counters of the calling thread. Counting is a plain increment of thread local memory; a run adds up what its
+// threads counted while it ran, see CounterScope.
+inline CounterBlock &threadCounters()
+{
+	thread_local CounterBlock block{};
+	return block;
+}
+inline void countEvent( Counter counter, uint64_t n = 1 )
+{
+	if constexpr ( AARF_PROFILE != 0 ) {
+		threadCounters()[static_cast<size_t>( counter )] += n;
+	}
+}
+
+// Worker threads hand their counts to the thread running the run: the worker takes what body() counted out of its
+// own counters with countedBy(), the owner adds it to its counters with countAll() after joining. Works the same
+// when the body runs inline on the owner.
+template<typename Body>
+CounterBlock countedBy( Body body )
+{
+	CounterBlock before = threadCounters();
+	body();
+	CounterBlock block = threadCounters();
+	for ( size_t i = 0; i < block.size(); ++i ) {
+		block[i] -= before[i];
+	}
+	threadCounters() = before;
+	return block;
+}
+inline void countAll( const CounterBlock &block )
+{
+	for ( size_t i = 0; i < block.size(); ++i ) {
+		threadCounters()[i] += block[i];
+	}
+}
+
+// What the calling thread counted since construction
+class CounterScope
+{
+public:
+	CounterScope() : start( threadCounters() ) {}
+	CounterBlock counted() const
+	{
+		CounterBlock block = threadCounters();
+		for ( size_t i = 0; i < block.size(); ++i ) {
+			block[i] -= start[i];
+		}
+		return block;
+	}
+
+private:
+	CounterBlock start;
+};
+
+struct ProfileSpan {
+	const char *name;
+	// 0 for the thread that started the run, workers are numbered from 1
+	unsigned thread;
+	// Seconds since the start of the profile
+	double start, seconds;
+};
+
+// Counters and spans of one run, filled by the run it is handed to
+struct Profile {
+	using Clock = std::chrono::steady_clock;
+
+	CounterBlock counters{};
+	std::vector<ProfileSpan> spans;
+	Clock::time_point origin = Clock::now();
+
+	uint64_t &operator[]( Counter counter ) { return counters[static_cast<size_t>( counter )]; }
+	uint64_t operator[]( Counter counter ) const { return counters[static_cast<size_t>( counter )]; }
+	// Seconds since origin, safe to call from any thread
+	double now() const { return std::chrono::duration<double>( Clock::now() - origin ).count(); }
+	void add( const CounterBlock &block )
+	{
+		for ( size_t i = 0; i < counters.size(); ++i ) {
+			counters[i] += block[i];
+		}
+	}
+};
+
+// Chrome trace event JSON, for chrome://tracing or Perfetto. Each profile becomes a process named by its string,
+// its spans complete events on their threads and its counters a counter event at the end of the run.
+void writeChromeTrace( std::ostream &out, const std::vector<std::tuple<std::string, const Profile *>> &processes );
+
+// Records the span from construction to destruction in profile, if there is one. Only for the thread owning the
+// profile; workers measure their span with Profile::now() and the owner appends it after joining them.
+class ProfileScope
+{
+public:
+	ProfileScope( Profile *profile, const char *name ) : profile( profile ), name( name ), start( profile ? profile->now() : 0 ) {}
+	ProfileScope( const ProfileScope & ) = delete;
+	ProfileScope &operator=( const ProfileScope & ) = delete;
+	~ProfileScope()
+	{
+		if ( profile ) {
+			profile->spans.push_back( { name, 0, start, profile->now() - start } );
+		}
+	}
+
+private:
+	Profile *profile;
+	const char *name;
+	double start;
+};
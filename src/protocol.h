@@ -0,0 +1,124 @@
+#pragma once
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <unistd.h>
+#include <vector>
+
+// Binary protocol of aarf_daemon over its Unix-domain socket.
+// Every message is a frame: a uint32 byte count, then that many bytes. Values are in host byte order, the socket
+// being local. A request frame is a batch of commands, each a DaemonOp byte followed by its arguments; the reply
+// frame has one result per command, a DaemonStatus byte followed by the values of the command when it is Ok.
+// A malformed command ends the batch, the commands after it get no result. A command whose result would take the
+// reply past maxFrameBytes gets TooLarge instead, and the batch ends once the reply is full. Large edge sets are
+// read in pages with Edges. Every edit of the graph bumps the version Edges reports, and pages only go together while
+// it stays the same; a client seeing it change starts over from the first page.
+//
+//   Info                                 -> double width, height; uint32 obstacles, nets
+//   AddNet     double x1, y1, x2, y2     -> uint32 net
+//   RemoveNet  uint32 net                -> (the last net takes its index)
+//   Locate     double x, y               -> uint8 free; double x1, y1, x2, y2, x3, y3
+//   Route      uint32 n; uint32 net * n  -> n * ( uint32 points; double x, y * points )
+//   RouteAll                             -> uint32 routed, unrouted, overflowEdges; double wirelength
+//   Edges      uint64 first; uint32 max  -> uint64 version, total; uint32 n; double x1, y1, x2, y2 * n
+//                                           (edges first.., n at most max and what the reply has room for)
+//   Shutdown                             -> (the daemon exits once the batch is answered)
+enum class DaemonOp : uint8_t
+{
+	Info = 1,
+	AddNet,
+	RemoveNet,
+	Locate,
+	Route,
+	RouteAll,
+	Edges,
+	Shutdown
+};
+
+enum class DaemonStatus : uint8_t
+{
+	Ok,
+	// Well formed but not applicable: an unknown net, a point outside the die or a page past the last edge. The
+	// batch goes on.
+	Invalid,
+	// Unknown op or arguments cut short. The batch ends here.
+	Malformed,
+	// The result does not fit in the reply frame. The batch goes on.
+	TooLarge
+};
+
+// Frames larger than this are refused and the connection closed
+constexpr uint32_t maxFrameBytes = 1u << 26;
+
+// Appends values to a frame
+struct FrameWriter {
+	std::vector<char> bytes;
+
+	template<typename T>
+	void put( T value )
+	{
+		bytes.insert( bytes.end(), reinterpret_cast<const char *>( &value ), reinterpret_cast<const char *>( &value ) + sizeof( T ) );
+	}
+};
+
+// Reads values off a frame; every get fails once the frame is exhausted
+struct FrameReader {
+	const char *next, *end;
+
+	template<typename T>
+	bool get( T &value )
+	{
+		if ( static_cast<size_t>( end - next ) < sizeof( T ) ) {
+			return false;
+		}
+		std::memcpy( &value, next, sizeof( T ) );
+		next += sizeof( T );
+		return true;
+	}
+	bool done() const { return next == end; }
+	size_t remaining() const { return end - next; }
+};
+
+// Blocking frame I/O on a socket, for clients. False on end of stream or error.
+inline bool writeAll( int fd, const char *bytes, size_t length )
+{
+	while ( length > 0 ) {
+		ssize_t written = ::write( fd, bytes, length );
+		if ( written < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( written <= 0 ) {
+			return false;
+		}
+		bytes += written, length -= written;
+	}
+	return true;
+}
+inline bool writeFrame( int fd, const std::vector<char> &frame )
+{
+	uint32_t length = frame.size();
+	return writeAll( fd, reinterpret_cast<const char *>( &length ), sizeof( length ) ) && writeAll( fd, frame.data(), frame.size() );
+}
+inline bool readAll( int fd, char *bytes, size_t length )
+{
+	while ( length > 0 ) {
+		ssize_t count = ::read( fd, bytes, length );
+		if ( count < 0 && errno == EINTR ) {
+			continue;
+		}
+		if ( count <= 0 ) {
+			return false;
+		}
+		bytes += count, length -= count;
+	}
+	return true;
+}
+inline bool readFrame( int fd, std::vector<char> &frame )
+{
+	uint32_t length;
+	if ( !readAll( fd, reinterpret_cast<char *>( &length ), sizeof( length ) ) || length > maxFrameBytes ) {
+		return false;
+	}
+	frame.resize( length );
+	return readAll( fd, frame.data(), length );
+}
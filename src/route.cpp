@@ -0,0 +1,28 @@
+#include "route.h"
+
+bool routeNets( Graph *graph, RouteStats *stats, const RouteOptions &options, CDTWorkspace *workspace )
+{
+	CDTOptions cdtOptions;
+	cdtOptions.threads = options.threads;
+	cdtOptions.control = options.control;
+	cdtOptions.refine = options.refine;
+	CDTHelper cdt( graph, stats ? &stats->cdt : nullptr, cdtOptions, workspace );
+	return cdt.construct() && Router( cdt, options ).routeAll( cdt, graph, stats );
+}
+
+std::vector<std::vector<Point>> DynamicCDT::route( const std::vector<int> &nets, const RouteOptions &options )
+{
+	Router router( *helper, options );
+	RouteSearch search( helper->mesh.last() + 1 );
+	std::vector<std::vector<Point>> routes( nets.size() );
+	std::vector<unsigned> crossed;
+	for ( size_t k = 0; k < nets.size(); ++k ) {
+		auto [a, b] = helper->cdt_graph.pins[nets[k]];
+		router.route( search, helper->node_alias[a], helper->node_alias[b], routes[k], crossed );
+	}
+	return routes;
+}
+bool DynamicCDT::routeAll( RouteStats *stats, const RouteOptions &options )
+{
+	return Router( *helper, options ).routeAll( *helper, graph, stats );
+}
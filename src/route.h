@@ -0,0 +1,337 @@
+#pragma once
+#include "cdt.h"
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <functional>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+// A* state of one routing thread. All buffers live as long as the router and are reused by every net; per triangle
+// entries are valid when seen matches the current generation.
+struct RouteSearch {
+	explicit RouteSearch( size_t triangles ) : best( triangles ), entry( triangles ), parent( triangles ), via( triangles ), seen( triangles, 0 ), closed( triangles, 0 ) {}
+
+	std::vector<double> best;
+	std::vector<Point> entry;
+	std::vector<unsigned> parent;
+	std::vector<uint8_t> via;
+	std::vector<uint32_t> seen, closed;
+	uint32_t generation = 0;
+	std::vector<std::tuple<double, double, unsigned>> open;
+	std::vector<std::tuple<unsigned, unsigned>> portals;
+	size_t expanded = 0;
+};
+
+// Net routing over the dual of the constrained triangulation.
+// A* runs over the free triangles, entering each one through the midpoint of the edge it was reached by; constrained
+// edges, the obstacle sides and the die boundary, are walls. Crossing an edge costs the distance travelled scaled by
+// how many of the wires the edge can hold are already used and by its history cost. The channel of triangles found
+// is then pulled tight by the funnel algorithm, so routes are shortest paths bending only at obstacle corners.
+// Nets are routed concurrently, each thread with its own RouteSearch; the wire count of every edge is shared and
+// updated atomically, so concurrent nets see each other's wires as they are committed. After the first pass, rounds
+// of negotiated congestion rip up the nets crossing overfull edges and route them again.
+struct Router {
+	Router( const CDTHelper &cdt, const RouteOptions &options )
+		: mesh( cdt.mesh ), nodes( cdt.cdt_graph.nodes ), options( options ), usage( 3 * ( mesh.last() + 1 ) ), capacity( 3 * ( mesh.last() + 1 ), 0 ),
+		  history( 3 * ( mesh.last() + 1 ), 0 )
+	{
+		for ( unsigned t = 1; t <= mesh.last(); ++t ) {
+			for ( unsigned i = 0; i < 3; i++ ) {
+				auto [x1, y1] = point( mesh.vertex( t, i ) );
+				auto [x2, y2] = point( mesh.vertex( t, ( i + 1 ) % 3 ) );
+				capacity[3 * t + i] = std::max( 1.0, std::floor( distance( x1, y1, x2, y2 ) / options.pitch ) );
+			}
+		}
+	}
+
+	// Route every net of the CDT graph and store the polylines in graph. False, with nothing stored, if
+	// options.control cancelled it.
+	bool routeAll( const CDTHelper &cdt, Graph *graph, RouteStats *stats )
+	{
+		Stopwatch watch;
+		size_t netCount = cdt.cdt_graph.pins.size();
+		std::vector<std::vector<Point>> routes( netCount );
+		// Edge slots crossed by every routed net, to rip it up later
+		std::vector<std::vector<unsigned>> crossed( netCount );
+		std::vector<unsigned> queue( netCount );
+		std::iota( queue.begin(), queue.end(), 0 );
+		unsigned threads = std::max( 1u, options.threads );
+		std::vector<RouteSearch> searches( threads, RouteSearch( mesh.last() + 1 ) );
+		size_t overfull = std::numeric_limits<size_t>::max();
+		// Rounds and the busy time of every worker go to the profile of the triangulation
+		Profile *profile = stats ? &stats->cdt.profile : nullptr;
+		for ( unsigned round = 0;; ++round ) {
+			const char *stage = round == 0 ? "routing" : "rerouting";
+			ProfileScope roundSpan( profile, stage );
+			// Nets finished, and the last progress step reported, in 1/256 of the queue
+			std::atomic<size_t> done{ 0 };
+			size_t reported = 0;
+			// First and last moment each worker was routing
+			std::vector<std::tuple<double, double>> busy( threads, { INFINITY, 0 } );
+			parallelForDynamic( threads, queue.size(), 16, [&]( unsigned worker, size_t begin, size_t end ) {
+				if ( jobCancelled( options.control ) ) {
+					return;
+				}
+				auto &[first, last] = busy[worker];
+				if ( profile ) {
+					first = std::min( first, profile->now() );
+				}
+				for ( size_t k = begin; k < end; ++k ) {
+					unsigned net = queue[k];
+					auto [a, b] = cdt.cdt_graph.pins[net];
+					route( searches[worker], cdt.node_alias[a], cdt.node_alias[b], routes[net], crossed[net] );
+				}
+				if ( profile ) {
+					last = profile->now();
+				}
+				// Worker 0 is the calling thread
+				size_t finished = done.fetch_add( end - begin, std::memory_order_relaxed ) + end - begin;
+				if ( worker == 0 && finished * 256 / queue.size() > reported ) {
+					reported = finished * 256 / queue.size();
+					reportProgress( options.control, stage, static_cast<double>( finished ) / queue.size() );
+				}
+			} );
+			for ( unsigned worker = 0; profile && worker < threads; ++worker ) {
+				auto [first, last] = busy[worker];
+				if ( first < last ) {
+					profile->spans.push_back( { "nets", worker, first, last - first } );
+				}
+			}
+			if ( jobCancelled( options.control ) ) {
+				return false;
+			}
+			if ( round == options.rounds || !ripUp( crossed, queue, overfull ) ) {
+				break;
+			}
+			if ( stats ) {
+				++stats->rounds;
+				stats->rerouted += queue.size();
+			}
+		}
+		for ( size_t net = 0; net < netCount; ++net ) {
+			if ( stats ) {
+				// Nets between unconnected pins keep an empty route
+				++( routes[net].empty() ? stats->unrouted : stats->routed );
+				stats->wirelength += length( routes[net] );
+			}
+			graph->setRoute( net, std::move( routes[net] ) );
+		}
+		if ( stats ) {
+			for ( const auto &search : searches ) {
+				stats->expanded += search.expanded;
+			}
+			stats->overflowEdges += overflowEdges();
+			stats->seconds += watch.elapsed();
+		}
+		return true;
+	}
+	// Raise the history cost of overfull edges and take the nets crossing them off the board. They become the new
+	// queue; false if no edge is overfull, or if no fewer are than the previous round left, given in `previous`
+	// and updated. On a die with far more nets than room, another round would only move the overflow around.
+	bool ripUp( std::vector<std::vector<unsigned>> &crossed, std::vector<unsigned> &queue, size_t &previous )
+	{
+		std::vector<bool> full( usage.size(), false );
+		size_t overfull = 0;
+		for ( size_t slot = 0; slot < usage.size(); ++slot ) {
+			full[slot] = usage[slot].load( std::memory_order_relaxed ) > capacity[slot];
+			overfull += full[slot];
+		}
+		queue.clear();
+		if ( overfull == 0 || overfull >= previous ) {
+			return false;
+		}
+		previous = overfull;
+		for ( size_t slot = 0; slot < usage.size(); ++slot ) {
+			if ( full[slot] ) {
+				double over = usage[slot].load( std::memory_order_relaxed ) - capacity[slot];
+				history[slot] += options.historyWeight * std::min( over / capacity[slot], 1.0 );
+			}
+		}
+		for ( unsigned net = 0; net < crossed.size(); ++net ) {
+			if ( std::any_of( crossed[net].begin(), crossed[net].end(), [&]( unsigned slot ) { return full[slot]; } ) ) {
+				for ( unsigned slot : crossed[net] ) {
+					usage[slot].fetch_sub( 1, std::memory_order_relaxed );
+				}
+				queue.push_back( net );
+			}
+		}
+		return !queue.empty();
+	}
+	// Shortest path from vertex a to vertex b, empty when they are not connected. The edge slots it crosses are
+	// counted as used and listed in edges.
+	bool route( RouteSearch &s, unsigned a, unsigned b, std::vector<Point> &path, std::vector<unsigned> &edges )
+	{
+		path.clear();
+		edges.clear();
+		if ( a == b ) {
+			path.push_back( point( a ) );
+			return true;
+		}
+		unsigned goal = search( s, a, b );
+		if ( goal == 0 ) {
+			return false;
+		}
+		// Portals from the start to the goal, each seen from the side the route comes from
+		s.portals.clear();
+		for ( unsigned t = goal; s.parent[t] != 0; t = s.parent[t] ) {
+			unsigned e = s.via[t];
+			s.portals.emplace_back( mesh.vertex( t, e ), mesh.vertex( t, ( e + 1 ) % 3 ) );
+			unsigned slot = edgeSlot( t, e );
+			usage[slot].fetch_add( 1, std::memory_order_relaxed );
+			edges.push_back( slot );
+		}
+		s.portals.emplace_back( a, a );
+		std::reverse( s.portals.begin(), s.portals.end() );
+		s.portals.emplace_back( b, b );
+		funnel( s.portals, path );
+		return true;
+	}
+	// A* from the triangles around a to one having b as a vertex. Returns that triangle, or 0.
+	unsigned search( RouteSearch &s, unsigned a, unsigned b )
+	{
+		if ( ++s.generation == 0 ) {
+			std::fill( s.seen.begin(), s.seen.end(), 0 );
+			std::fill( s.closed.begin(), s.closed.end(), 0 );
+			s.generation = 1;
+		}
+		s.open.clear();
+		auto [ax, ay] = point( a );
+		auto [bx, by] = point( b );
+		unsigned start = mesh.vertexTriangle( a ), t = start;
+		do {
+			unsigned k = mesh.indexOf( t, a );
+			if ( !mesh.isHole( t ) ) {
+				relax( s, t, 0, 0, ax, ay, 0, distance( ax, ay, bx, by ) );
+			}
+			t = mesh.adjacent( t, ( k + 2 ) % 3 );
+		} while ( t != start && t != 0 );
+		while ( !s.open.empty() ) {
+			std::pop_heap( s.open.begin(), s.open.end(), std::greater<>() );
+			auto [f, g, t] = s.open.back();
+			s.open.pop_back();
+			if ( g > s.best[t] || s.closed[t] == s.generation ) {
+				continue;
+			}
+			// Never reopened: with a weighted estimate that costs a little optimality but bounds the work per net
+			s.closed[t] = s.generation;
+			++s.expanded;
+			if ( mesh.vertex( t, 0 ) == b || mesh.vertex( t, 1 ) == b || mesh.vertex( t, 2 ) == b ) {
+				return t;
+			}
+			auto [x, y] = s.entry[t];
+			for ( unsigned i = 0; i < 3; i++ ) {
+				unsigned u = mesh.adjacent( t, i );
+				if ( u == 0 || u == s.parent[t] || mesh.isConstrained( t, i ) || mesh.isHole( u ) ) {
+					continue;
+				}
+				auto [x1, y1] = point( mesh.vertex( t, i ) );
+				auto [x2, y2] = point( mesh.vertex( t, ( i + 1 ) % 3 ) );
+				double mx = ( x1 + x2 ) / 2, my = ( y1 + y2 ) / 2;
+				double step = distance( x, y, mx, my ) * congestion( edgeSlot( t, i ) );
+				relax( s, u, t, mesh.adjacentEdge( t, i ), mx, my, g + step, options.heuristicWeight * distance( mx, my, bx, by ) );
+			}
+		}
+		return 0;
+	}
+	// Reach t from triangle from through its edge `edge` at (x, y), g so far and h estimated to go
+	void relax( RouteSearch &s, unsigned t, unsigned from, unsigned edge, double x, double y, double g, double h )
+	{
+		if ( s.seen[t] == s.generation && ( s.best[t] <= g || s.closed[t] == s.generation ) ) {
+			return;
+		}
+		s.seen[t] = s.generation;
+		s.best[t] = g, s.parent[t] = from, s.via[t] = edge, s.entry[t] = { x, y };
+		s.open.emplace_back( g + h, g, t );
+		std::push_heap( s.open.begin(), s.open.end(), std::greater<>() );
+	}
+	// Cost factor for crossing an edge: 1 when empty and never overfull, growing with its use and history
+	double congestion( unsigned slot ) const
+	{
+		double used = usage[slot].load( std::memory_order_relaxed );
+		double present = 1 + options.congestionWeight * std::min( used / capacity[slot], 1.0 ) + ( used >= capacity[slot] ? options.overflowPenalty : 0 );
+		return ( 1 + history[slot] ) * present;
+	}
+	// Both sides of an edge share the counters of the lower triangle slot
+	unsigned edgeSlot( unsigned t, unsigned i ) const
+	{
+		unsigned u = mesh.adjacent( t, i ), j = mesh.adjacentEdge( t, i );
+		return std::min( 3 * t + i, u != 0 ? 3 * u + j : 3 * t + i );
+	}
+	size_t overflowEdges() const
+	{
+		size_t overflow = 0;
+		for ( size_t slot = 0; slot < usage.size(); ++slot ) {
+			overflow += usage[slot].load( std::memory_order_relaxed ) > capacity[slot];
+		}
+		return overflow;
+	}
+	// Simple stupid funnel algorithm (Mononen) over the portals, left and right as seen walking towards the goal
+	void funnel( const std::vector<std::tuple<unsigned, unsigned>> &portals, std::vector<Point> &path ) const
+	{
+		unsigned apex = std::get<0>( portals[0] ), left = apex, right = apex;
+		size_t apexIndex = 0, leftIndex = 0, rightIndex = 0;
+		path.push_back( point( apex ) );
+		for ( size_t i = 1; i < portals.size(); ++i ) {
+			auto [l, r] = portals[i];
+			// Narrow the right side, or turn around the left corner once the new right crosses it
+			if ( orient( apex, right, r ) >= 0 ) {
+				if ( apex == right || orient( apex, left, r ) < 0 ) {
+					right = r, rightIndex = i;
+				} else {
+					path.push_back( point( left ) );
+					apex = right = left;
+					apexIndex = rightIndex = leftIndex;
+					i = apexIndex;
+					continue;
+				}
+			}
+			if ( orient( apex, left, l ) <= 0 ) {
+				if ( apex == left || orient( apex, right, l ) > 0 ) {
+					left = l, leftIndex = i;
+				} else {
+					path.push_back( point( right ) );
+					apex = left = right;
+					apexIndex = leftIndex = rightIndex;
+					i = apexIndex;
+					continue;
+				}
+			}
+		}
+		path.push_back( point( std::get<0>( portals.back() ) ) );
+	}
+	double orient( unsigned a, unsigned b, unsigned c ) const
+	{
+		auto [xa, ya] = point( a );
+		auto [xb, yb] = point( b );
+		auto [xc, yc] = point( c );
+		return orient2d( xa, ya, xb, yb, xc, yc );
+	}
+	Point point( unsigned p ) const
+	{
+		return { nodes.x[p], nodes.y[p] };
+	}
+	static double distance( double x1, double y1, double x2, double y2 )
+	{
+		return std::sqrt( ( x2 - x1 ) * ( x2 - x1 ) + ( y2 - y1 ) * ( y2 - y1 ) );
+	}
+	static double length( const std::vector<Point> &path )
+	{
+		double total = 0;
+		for ( size_t i = 1; i < path.size(); ++i ) {
+			total += distance( std::get<0>( path[i - 1] ), std::get<1>( path[i - 1] ), std::get<0>( path[i] ), std::get<1>( path[i] ) );
+		}
+		return total;
+	}
+
+	const TriangleMesh &mesh;
+	const NodeBuffer &nodes;
+	RouteOptions options;
+	// Per edge slot, see edgeSlot(): wires crossing it, wires it holds and history cost. Only the lower slot of an
+	// edge is used, capacity is filled in for both.
+	std::vector<std::atomic<uint32_t>> usage;
+	std::vector<double> capacity;
+	std::vector<double> history;
+};
@@ -0,0 +1,14 @@
+#include "tiled.h"
+
+bool constructCDTTiled( const Graph &graph, const char *path, TiledCDTStats *stats, const TiledCDTOptions &options )
+{
+	LayoutWriter out( path, graph.getWidth(), graph.getHeight() );
+	for ( const auto &obstacle : graph.getObstacles() ) {
+		out.addObstacle( obstacle );
+	}
+	for ( const auto &net : graph.getNets() ) {
+		out.addNet( net );
+	}
+	bool complete = TiledCDT( graph, out, stats, options ).construct();
+	return out.finish() && complete;
+}
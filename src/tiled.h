@@ -0,0 +1,472 @@
+#pragma once
+#include "cdt.h"
+#include "layout.h"
+#include <cstdio>
+
+// Out-of-core CDT construction, see constructCDTTiled.
+// The die is cut into square cores and every tile triangulates its core and a margin around it: each obstacle
+// reaching into that area, each pin inside it, and the die. A free triangle of a tile whose circumcircle lies inside
+// the area and has no other vertex on it sees every vertex and constraint that could keep it from being Delaunay,
+// so it is a triangle of the whole CDT, the same in every tile that can tell. It is settled by the tile whose core
+// holds its centroid: its edges are written out and the tile is dropped.
+// What no tile settles, big triangles along the die sides, long obstacle sides and the tile seams, goes to the
+// stitch: one more CDT of the vertices of unsettled triangles, walled in by the constraints at those vertices and
+// by the edges between settled and unsettled triangles. Its faces lying on settled triangles are found from their
+// centroids, kept on disk meanwhile, and only the rest is written.
+// The stitch is a single CDT over the whole die and is held in memory with its input, the walls and open vertices
+// gathered from every tile. Peak memory is that of the largest tile plus the stitch, which grows with the total
+// length of the seams, the die sides and the long obstacle sides; TiledCDTStats::stitchNodes reports its size.
+// Every coordinate is normalized like CDTHelper does it, so all tiles and the stitch agree on every predicate, and
+// edges are written in the coordinates constructCDT would give them.
+// Sides of the die under an obstacle belong to no free triangle and are written on their own, see writeCoveredSides.
+struct TiledCDT {
+	TiledCDT( const Graph &graph, LayoutWriter &out, TiledCDTStats *stats, const TiledCDTOptions &options )
+		: graph( graph ), out( out ), stats( stats ), options( options ), dmax( std::max( graph.getWidth(), graph.getHeight() ) ),
+		  side( options.tileSize / dmax ), margin( options.margin * side ),
+		  columns( std::max( 1.0, std::ceil( graph.getWidth() / options.tileSize ) ) ), rows( std::max( 1.0, std::ceil( graph.getHeight() / options.tileSize ) ) )
+	{
+		// Tiles take everything within a slightly wider margin than the one triangles are checked against, so
+		// rounding at the border cannot leave out anything a settled triangle depends on
+		double reach = margin * 1.01;
+		auto cells = [&]( double lo, double hi, unsigned count ) {
+			auto cell = [&]( double v ) { return static_cast<unsigned>( std::clamp( std::floor( v / side ), 0.0, count - 1.0 ) ); };
+			return std::tuple{ cell( lo - reach ), cell( hi + reach ) };
+		};
+		auto &obstacles = graph.getObstacles();
+		bucket( obstacle_start, obstacle_index, obstacles.size(), [&]( size_t i ) {
+			auto [p1, p2] = obstacles[i];
+			auto [c0, c1] = cells( std::get<0>( p1 ) / dmax, std::get<0>( p2 ) / dmax, columns );
+			auto [r0, r1] = cells( std::get<1>( p1 ) / dmax, std::get<1>( p2 ) / dmax, rows );
+			return std::tuple{ c0, c1, r0, r1 };
+		} );
+		auto &nets = graph.getNets();
+		bucket( pin_start, pin_index, 2 * nets.size(), [&]( size_t i ) {
+			auto [x, y] = pin( i );
+			auto [c0, c1] = cells( x / dmax, x / dmax, columns );
+			auto [r0, r1] = cells( y / dmax, y / dmax, rows );
+			return std::tuple{ c0, c1, r0, r1 };
+		} );
+	}
+	TiledCDT( const TiledCDT & ) = delete;
+	TiledCDT &operator=( const TiledCDT & ) = delete;
+	~TiledCDT()
+	{
+		if ( settled ) {
+			std::fclose( settled );
+		}
+	}
+
+	bool construct()
+	{
+		Stopwatch watch;
+		CounterScope counters;
+		Profile *profile = stats ? &stats->cdt.profile : nullptr;
+		settled = std::tmpfile();
+		if ( !settled ) {
+			return false;
+		}
+		for ( unsigned row = 0; row < rows; ++row ) {
+			for ( unsigned column = 0; column < columns; ++column ) {
+				ProfileScope span( profile, "tile" );
+				if ( !constructTile( column, row ) ) {
+					return false;
+				}
+				reportProgress( options.cdt.control, "tiles", static_cast<double>( row * columns + column + 1 ) / ( rows * columns ) );
+			}
+		}
+		{
+			ProfileScope span( profile, "stitch" );
+			if ( !stitch() ) {
+				return false;
+			}
+		}
+		writeCoveredSides();
+		if ( stats ) {
+			stats->tiles += rows * columns;
+			stats->cdt.nodes = 4 * ( graph.getObstacles().size() + 1 ) + 2 * graph.getNets().size();
+			stats->cdt.triangles = stats->tileTriangles + stats->stitchTriangles;
+			stats->cdt.profile.add( counters.counted() );
+			stats->peakRssKb = peakRssKb();
+			stats->seconds += watch.elapsed();
+		}
+		return out.ok();
+	}
+
+	// Triangulate one tile, write what it settles, and keep what it leaves for the stitch
+	bool constructTile( unsigned column, unsigned row )
+	{
+		unsigned tile = row * columns + column;
+		std::vector<TwoPoints> obstacles, pins;
+		for ( unsigned k = obstacle_start[tile]; k < obstacle_start[tile + 1]; ++k ) {
+			obstacles.push_back( graph.getObstacles()[obstacle_index[k]] );
+		}
+		// Lone pins, as nets from a pin to itself
+		for ( unsigned k = pin_start[tile]; k < pin_start[tile + 1]; ++k ) {
+			pins.emplace_back( pin( pin_index[k] ), pin( pin_index[k] ) );
+		}
+		Graph tileGraph( graph.getWidth(), graph.getHeight(), std::move( obstacles ), std::move( pins ) );
+		CDTHelper cdt( &tileGraph, stats ? &stats->cdt : nullptr, options.cdt, &workspace );
+		if ( !cdt.triangulate() ) {
+			return false;
+		}
+		auto &mesh = cdt.mesh;
+		auto &nodes = cdt.cdt_graph.nodes;
+		if ( stats ) {
+			stats->maxTileNodes = std::max( stats->maxTileNodes, nodes.size() - 3 );
+		}
+
+		std::vector<uint8_t> final( mesh.last() + 1, 0 ), open( nodes.size(), 0 );
+		for ( unsigned t = 1; t <= mesh.last(); ++t ) {
+			if ( !isFree( cdt, t ) ) {
+				continue;
+			}
+			double x, y, radius;
+			circle( cdt, t, x, y, radius );
+			auto [cx, cy] = centroid( cdt, t );
+			final[t] = fits( x, y, radius, column, row ) && fits( x, y, radius, columnOf( cx ), rowOf( cy ) ) && isStrong( cdt, t );
+			if ( !final[t] ) {
+				for ( unsigned i = 0; i < 3; i++ ) {
+					open[mesh.vertex( t, i )] = 1;
+				}
+			}
+		}
+		for ( unsigned t = 1; t <= mesh.last(); ++t ) {
+			auto [cx, cy] = centroid( cdt, t );
+			if ( !final[t] || columnOf( cx ) != column || rowOf( cy ) != row ) {
+				continue;
+			}
+			Point c{ cx, cy };
+			if ( std::fwrite( &c, sizeof( c ), 1, settled ) != 1 ) {
+				return false;
+			}
+			for ( unsigned i = 0; i < 3; i++ ) {
+				unsigned a = mesh.vertex( t, i ), b = mesh.vertex( t, ( i + 1 ) % 3 ), u = mesh.adjacent( t, i );
+				// Edges between free triangles are written by the side seeing them run upwards, like extractCDTEdges
+				if ( u == 0 || !isFree( cdt, u ) || upward( position( cdt, a ), position( cdt, b ) ) ) {
+					writeEdge( position( cdt, a ), position( cdt, b ) );
+				}
+				// A seam, the stitch triangulates what is on its other side
+				if ( !mesh.isConstrained( t, i ) && !final[u] ) {
+					walls.push_back( { position( cdt, a ), position( cdt, b ), true, false, false } );
+				}
+			}
+			if ( stats ) {
+				++stats->tileTriangles;
+			}
+		}
+		// Open vertices in the core, with every constraint they are on
+		for ( unsigned p = 0; p < nodes.size(); ++p ) {
+			auto [x, y] = nodes[p];
+			if ( !open[p] || cdt.isSuper( p ) || cdt.node_alias[p] != p || columnOf( x ) != column || rowOf( y ) != row ) {
+				continue;
+			}
+			stitch_points.push_back( position( cdt, p ) );
+			unsigned start = mesh.vertexTriangle( p ), t = start;
+			do {
+				unsigned k = mesh.indexOf( t, p ), u = mesh.adjacent( t, k );
+				if ( mesh.isConstrained( t, k ) ) {
+					walls.push_back( { position( cdt, p ), position( cdt, mesh.vertex( t, ( k + 1 ) % 3 ) ), false, mesh.isHole( t ), u != 0 && mesh.isHole( u ) } );
+				}
+				t = mesh.adjacent( t, ( k + 2 ) % 3 );
+			} while ( t != start );
+		}
+		return true;
+	}
+
+	// Triangulate what the tiles left open and write its part of the CDT
+	bool stitch()
+	{
+		// The die in normalized coordinates, whose longer side is exactly 1, so the stitch keeps every coordinate
+		Graph stitchGraph( graph.getWidth() / dmax, graph.getHeight() / dmax, {}, {} );
+		CDTHelper cdt( &stitchGraph, stats ? &stats->cdt : nullptr, options.cdt, &workspace );
+		auto &nodes = cdt.cdt_graph.nodes;
+		std::vector<Point> positions = std::move( stitch_points );
+		for ( auto &wall : walls ) {
+			positions.push_back( wall.a );
+			positions.push_back( wall.b );
+		}
+		std::sort( positions.begin(), positions.end() );
+		positions.erase( std::unique( positions.begin(), positions.end() ), positions.end() );
+		unsigned first = nodes.size();
+		auto indexOf = [&]( const Point &p ) { return first + static_cast<unsigned>( std::lower_bound( positions.begin(), positions.end(), p ) - positions.begin() ); };
+		for ( auto [x, y] : positions ) {
+			nodes.push( x, y );
+		}
+		for ( auto &wall : walls ) {
+			cdt.cdt_graph.constrained_edges.emplace_back( indexOf( wall.a ), indexOf( wall.b ) );
+		}
+		if ( stats ) {
+			stats->stitchNodes = nodes.size();
+		}
+		if ( !cdt.triangulate() ) {
+			return false;
+		}
+		cdt.buildLocator();
+
+		// Nodes were reordered by the build, find them again by position
+		std::vector<unsigned> byPosition;
+		for ( unsigned p = 0; p < nodes.size(); ++p ) {
+			if ( !cdt.isSuper( p ) && cdt.node_alias[p] == p ) {
+				byPosition.push_back( p );
+			}
+		}
+		std::sort( byPosition.begin(), byPosition.end(), [&]( unsigned a, unsigned b ) { return position( cdt, a ) < position( cdt, b ); } );
+		auto find = [&]( const Point &p ) {
+			return *std::lower_bound( byPosition.begin(), byPosition.end(), p, [&]( unsigned a, const Point &q ) { return position( cdt, a ) < q; } );
+		};
+		// Drop the obstacle sides of the walls, then every face holding a settled triangle. What is left open is
+		// exactly the free space the tiles did not settle.
+		std::vector<uint64_t> seams;
+		for ( auto &wall : walls ) {
+			unsigned a = find( wall.a ), b = find( wall.b );
+			if ( wall.seam ) {
+				seams.push_back( edgeKey( a, b ) );
+			}
+			if ( wall.holeLeft ) {
+				cdt.fillRegion( sideTriangle( cdt, a, b, true ), true );
+			}
+			if ( wall.holeRight ) {
+				cdt.fillRegion( sideTriangle( cdt, a, b, false ), true );
+			}
+		}
+		std::sort( seams.begin(), seams.end() );
+		walls.clear();
+		walls.shrink_to_fit();
+		std::rewind( settled );
+		Point batch[4096];
+		for ( size_t count; ( count = std::fread( batch, sizeof( Point ), std::size( batch ), settled ) ) > 0; ) {
+			for ( size_t i = 0; i < count; ++i ) {
+				auto [x, y] = batch[i];
+				unsigned t = cdt.locate( x, y );
+				if ( t != 0 && !cdt.mesh.isHole( t ) ) {
+					cdt.fillRegion( t, true );
+				}
+			}
+		}
+		if ( std::ferror( settled ) ) {
+			return false;
+		}
+
+		auto &mesh = cdt.mesh;
+		for ( unsigned t = 1; t <= mesh.last(); ++t ) {
+			if ( !isFree( cdt, t ) ) {
+				continue;
+			}
+			for ( unsigned i = 0; i < 3; i++ ) {
+				unsigned a = mesh.vertex( t, i ), b = mesh.vertex( t, ( i + 1 ) % 3 );
+				// Other constrained edges have an obstacle or the outside of the die behind them. Seams have a
+				// settled triangle, which writes them when they run upwards from its side.
+				bool side = mesh.isConstrained( t, i ) && !std::binary_search( seams.begin(), seams.end(), edgeKey( a, b ) );
+				if ( side || upward( position( cdt, a ), position( cdt, b ) ) ) {
+					writeEdge( position( cdt, a ), position( cdt, b ) );
+				}
+			}
+			if ( stats ) {
+				++stats->stitchTriangles;
+			}
+		}
+		return true;
+	}
+
+	// Where an obstacle lies on a side of the die, the side between two vertices has a hole on the inside and the
+	// outside on the other, so neither a tile nor the stitch writes it. These are found along the sides instead:
+	// every vertex on a side splits it, and the pieces covered by an obstacle are written.
+	void writeCoveredSides()
+	{
+		double w = graph.getWidth() / dmax, h = graph.getHeight() / dmax;
+		// Vertices and covered intervals of each side, as positions along it: bottom, top, left, right
+		std::array<std::vector<double>, 4> vertices;
+		std::array<std::vector<std::tuple<double, double>>, 4> covered;
+		auto addPoint = [&]( double x, double y ) {
+			for ( auto [side, on, along] : { std::tuple{ 0, y == 0, x }, { 1, y == h, x }, { 2, x == 0, y }, { 3, x == w, y } } ) {
+				if ( on ) {
+					vertices[side].push_back( along );
+				}
+			}
+		};
+		addPoint( 0, 0 ), addPoint( w, 0 ), addPoint( 0, h ), addPoint( w, h );
+		for ( auto [p1, p2] : graph.getObstacles() ) {
+			double x1 = std::get<0>( p1 ) / dmax, y1 = std::get<1>( p1 ) / dmax, x2 = std::get<0>( p2 ) / dmax, y2 = std::get<1>( p2 ) / dmax;
+			addPoint( x1, y1 ), addPoint( x2, y1 ), addPoint( x1, y2 ), addPoint( x2, y2 );
+			for ( auto [side, on, lo, hi] : { std::tuple{ 0, y1 == 0, x1, x2 }, { 1, y2 == h, x1, x2 }, { 2, x1 == 0, y1, y2 }, { 3, x2 == w, y1, y2 } } ) {
+				if ( on ) {
+					covered[side].emplace_back( lo, hi );
+				}
+			}
+		}
+		for ( size_t i = 0; i < 2 * graph.getNets().size(); ++i ) {
+			auto [x, y] = pin( i );
+			addPoint( x / dmax, y / dmax );
+		}
+		for ( int side = 0; side < 4; ++side ) {
+			auto &along = vertices[side];
+			auto &intervals = covered[side];
+			std::sort( along.begin(), along.end() );
+			along.erase( std::unique( along.begin(), along.end() ), along.end() );
+			std::sort( intervals.begin(), intervals.end() );
+			// Intervals are visited by their start, reach is the furthest end among those starting before mid
+			size_t next = 0;
+			double reach = -1;
+			for ( size_t k = 0; k + 1 < along.size(); ++k ) {
+				double mid = ( along[k] + along[k + 1] ) / 2;
+				for ( ; next < intervals.size() && std::get<0>( intervals[next] ) < mid; ++next ) {
+					reach = std::max( reach, std::get<1>( intervals[next] ) );
+				}
+				if ( reach > mid ) {
+					double fixed = side == 0 ? 0 : side == 1 ? h : side == 2 ? 0 : w;
+					side < 2 ? writeEdge( { along[k], fixed }, { along[k + 1], fixed } ) : writeEdge( { fixed, along[k] }, { fixed, along[k + 1] } );
+				}
+			}
+		}
+	}
+	// CSR lists of the items reaching into every tile. cells( i ) gives the column and row ranges of item i.
+	template<typename Cells>
+	void bucket( std::vector<unsigned> &start, std::vector<unsigned> &index, size_t count, Cells cells )
+	{
+		start.assign( rows * columns + 1, 0 );
+		for ( int pass = 0; pass < 2; ++pass ) {
+			for ( size_t i = 0; i < count; ++i ) {
+				auto [c0, c1, r0, r1] = cells( i );
+				for ( unsigned r = r0; r <= r1; ++r ) {
+					for ( unsigned c = c0; c <= c1; ++c ) {
+						if ( pass == 0 ) {
+							++start[r * columns + c + 1];
+						} else {
+							index[start[r * columns + c]++] = i;
+						}
+					}
+				}
+			}
+			if ( pass == 0 ) {
+				std::partial_sum( start.begin(), start.end(), start.begin() );
+				index.resize( start.back() );
+			} else {
+				// The fill moved every start to the next one
+				std::copy_backward( start.begin(), start.end() - 1, start.end() );
+				start[0] = 0;
+			}
+		}
+	}
+	// Pin i of the graph, both ends of every net in turn
+	Point pin( size_t i ) const
+	{
+		auto &[p1, p2] = graph.getNets()[i / 2];
+		return i % 2 ? p2 : p1;
+	}
+	// Core of a normalized coordinate. Cores are only ever told apart by these two, so every tile agrees on them.
+	unsigned columnOf( double x ) const
+	{
+		return static_cast<unsigned>( std::clamp( std::floor( x / side ), 0.0, columns - 1.0 ) );
+	}
+	unsigned rowOf( double y ) const
+	{
+		return static_cast<unsigned>( std::clamp( std::floor( y / side ), 0.0, rows - 1.0 ) );
+	}
+	// Whether the circle lies inside the area of the tile, with room for the rounding of the circle
+	bool fits( double x, double y, double radius, unsigned column, unsigned row ) const
+	{
+		double r = radius * ( 1 + 1e-9 ) + 1e-12;
+		return x - r > column * side - margin && x + r < ( column + 1 ) * side + margin && y - r > row * side - margin && y + r < ( row + 1 ) * side + margin;
+	}
+	// Free: neither in an obstacle nor outside the die, which only triangles with a super vertex are
+	static bool isFree( const CDTHelper &cdt, unsigned t )
+	{
+		return !cdt.mesh.isHole( t ) && !cdt.isSuper( cdt.mesh.vertex( t, 0 ) ) && !cdt.isSuper( cdt.mesh.vertex( t, 1 ) ) && !cdt.isSuper( cdt.mesh.vertex( t, 2 ) );
+	}
+	// No neighbour across a free edge has its far vertex on the circle of t, so t is in every CDT of the points
+	// within that circle rather than one of several equally good choices
+	static bool isStrong( CDTHelper &cdt, unsigned t )
+	{
+		auto &mesh = cdt.mesh;
+		auto &nodes = cdt.cdt_graph.nodes;
+		for ( unsigned i = 0; i < 3; i++ ) {
+			unsigned u = mesh.adjacent( t, i );
+			if ( u == 0 || mesh.isConstrained( t, i ) ) {
+				continue;
+			}
+			auto [x1, y1] = nodes[mesh.vertex( t, 0 )];
+			auto [x2, y2] = nodes[mesh.vertex( t, 1 )];
+			auto [x3, y3] = nodes[mesh.vertex( t, 2 )];
+			auto [x, y] = nodes[mesh.vertex( u, ( mesh.adjacentEdge( t, i ) + 2 ) % 3 )];
+			if ( incircle( x1, y1, x2, y2, x3, y3, x, y ) >= 0 ) {
+				return false;
+			}
+		}
+		return true;
+	}
+	static void circle( CDTHelper &cdt, unsigned t, double &x, double &y, double &radius )
+	{
+		unsigned a = cdt.mesh.vertex( t, 0 );
+		cdt.circumcenter( a, cdt.mesh.vertex( t, 1 ), cdt.mesh.vertex( t, 2 ), x, y );
+		auto [ax, ay] = cdt.cdt_graph.nodes[a];
+		radius = std::hypot( ax - x, ay - y );
+	}
+	static Point position( const CDTHelper &cdt, unsigned p )
+	{
+		auto [x, y] = cdt.cdt_graph.nodes[p];
+		return { x, y };
+	}
+	static Point centroid( const CDTHelper &cdt, unsigned t )
+	{
+		auto [x1, y1] = cdt.cdt_graph.nodes[cdt.mesh.vertex( t, 0 )];
+		auto [x2, y2] = cdt.cdt_graph.nodes[cdt.mesh.vertex( t, 1 )];
+		auto [x3, y3] = cdt.cdt_graph.nodes[cdt.mesh.vertex( t, 2 )];
+		return { ( x1 + x2 + x3 ) / 3, ( y1 + y2 + y3 ) / 3 };
+	}
+	// The triangle at a on the left, or on the right, of the constrained edge starting at a towards b
+	static unsigned sideTriangle( CDTHelper &cdt, unsigned a, unsigned b, bool left )
+	{
+		auto &mesh = cdt.mesh;
+		unsigned t = mesh.vertexTriangle( a );
+		for ( ;; ) {
+			unsigned k = mesh.indexOf( t, a ), v = mesh.vertex( t, left ? ( k + 1 ) % 3 : ( k + 2 ) % 3 );
+			if ( cdt.orient( a, v, b ) == 0 && cdt.inFront( a, b, v ) ) {
+				return t;
+			}
+			t = mesh.adjacent( t, ( k + 2 ) % 3 );
+		}
+	}
+	// Of the two triangles sharing a free edge, the one seeing it run upwards writes it
+	static bool upward( Point a, Point b )
+	{
+		auto [xa, ya] = a;
+		auto [xb, yb] = b;
+		return std::tie( ya, xa ) < std::tie( yb, xb );
+	}
+	static uint64_t edgeKey( unsigned a, unsigned b )
+	{
+		return uint64_t( std::min( a, b ) ) << 32 | std::max( a, b );
+	}
+	void writeEdge( Point a, Point b )
+	{
+		auto [xa, ya] = a;
+		auto [xb, yb] = b;
+		out.addCdtEdge( { { xa * dmax, ya * dmax }, { xb * dmax, yb * dmax } } );
+		if ( stats ) {
+			++stats->cdt.edges;
+		}
+	}
+
+	// A constraint of the stitch: either a seam, an edge with a settled triangle on its left, or a constrained edge
+	// at an open vertex with the obstacle sides it has
+	struct Wall {
+		Point a, b;
+		bool seam, holeLeft, holeRight;
+	};
+
+	const Graph &graph;
+	LayoutWriter &out;
+	TiledCDTStats *stats;
+	const TiledCDTOptions &options;
+	// Normalization of CDTHelper, core side and margin in normalized units
+	double dmax, side, margin;
+	unsigned columns, rows;
+	std::vector<unsigned> obstacle_start, obstacle_index, pin_start, pin_index;
+	// Buffers of one tile, reused by the next
+	CDTWorkspace workspace;
+	// Input of the stitch, in normalized coordinates
+	std::vector<Point> stitch_points;
+	std::vector<Wall> walls;
+	// Centroids of the settled triangles
+	std::FILE *settled = nullptr;
+};
@@ -0,0 +1,112 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Tracing and validation for CDTHelper. The level is fixed at compile time through AARF_TRACE_LEVEL:
+//   0 - nothing, all trace calls compile away
+//   1 - per-insertion events are written to a buffered binary trace file, when AARF_TRACE_FILE names one
+//   2 - events plus a full mesh consistency check after every insertion, O( n^2 ) and only on request
+#ifndef AARF_TRACE_LEVEL
+#define AARF_TRACE_LEVEL 0
+#endif
+
+enum class TraceLevel
+{
+	None = 0,
+	Events = 1,
+	Validate = 2
+};
+
+constexpr TraceLevel traceLevel = static_cast<TraceLevel>( AARF_TRACE_LEVEL );
+
+enum class TraceEvent : uint32_t
+{
+	Normalize,       // a = node count
+	BinSort,         // a = node count, b = bins per side
+	SuperTriangle,   // a, b, c = super triangle vertices
+	Locate,          // a = node, b = enclosing triangle, c = walk steps, x/y = node position
+	Split,           // a = split triangle, b = node, c = first new triangle
+	Flip,            // a, b = flipped triangle pair, c = node being legalized
+	ValidationFailed // a = node inserted last
+};
+
+// Fixed size record, the trace file is a plain array of these. Indices are 64 bits wide so the 64-bit engine
+// traces without truncation.
+struct TraceRecord {
+	TraceEvent event;
+	uint64_t a, b, c;
+	double x, y;
+};
+static_assert( sizeof( TraceRecord ) == 48, "trace records must stay 48 bytes" );
+
+// Buffered binary trace writer. Nothing is written unless AARF_TRACE_FILE is set. Every tracer then has a file of its
+// own, so tiles, resident triangulations and concurrent workers do not truncate or interleave each other: the path
+// suffixed with the process id and the number of the tracer in the process, e.g. cdt_trace.bin.1234.0.
+template<TraceLevel level>
+class Tracer
+{
+public:
+	static constexpr bool enabled = true;
+	static constexpr bool validating = level >= TraceLevel::Validate;
+
+	Tracer()
+	{
+		static std::atomic<unsigned> tracers{ 0 };
+		auto base = std::getenv( "AARF_TRACE_FILE" );
+		if ( !base || !*base ) {
+			return;
+		}
+		auto path = std::string( base ) + "." + std::to_string( getpid() ) + "." + std::to_string( tracers++ );
+		file = std::fopen( path.c_str(), "wb" );
+		buffer.reserve( bufferSize );
+	}
+	Tracer( const Tracer & ) = delete;
+	Tracer &operator=( const Tracer & ) = delete;
+	~Tracer()
+	{
+		flush();
+		if ( file ) {
+			std::fclose( file );
+		}
+	}
+	void record( TraceEvent event, uint64_t a = 0, uint64_t b = 0, uint64_t c = 0, double x = 0, double y = 0 )
+	{
+		if ( !file ) {
+			return;
+		}
+		buffer.push_back( { event, a, b, c, x, y } );
+		if ( buffer.size() == bufferSize ) {
+			flush();
+		}
+	}
+	void flush()
+	{
+		if ( file && !buffer.empty() ) {
+			std::fwrite( buffer.data(), sizeof( TraceRecord ), buffer.size(), file );
+			std::fflush( file );
+		}
+		buffer.clear();
+	}
+
+private:
+	static constexpr size_t bufferSize = 4096;
+	std::FILE *file = nullptr;
+	std::vector<TraceRecord> buffer;
+};
+
+// Release builds: every call is an empty inline function
+template<>
+class Tracer<TraceLevel::None>
+{
+public:
+	static constexpr bool enabled = false;
+	static constexpr bool validating = false;
+
+	void record( TraceEvent, uint64_t = 0, uint64_t = 0, uint64_t = 0, double = 0, double = 0 ) {}
+	void flush() {}
+};
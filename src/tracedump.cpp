@@ -0,0 +1,45 @@
+// Prints a binary CDT trace file written by Tracer as text
+#include "trace.h"
+#include <cstdio>
+
+static const char *eventName( TraceEvent event )
+{
+	switch ( event ) {
+		case TraceEvent::Normalize:
+			return "normalize";
+		case TraceEvent::BinSort:
+			return "binSort";
+		case TraceEvent::SuperTriangle:
+			return "superTriangle";
+		case TraceEvent::Locate:
+			return "locate";
+		case TraceEvent::Split:
+			return "split";
+		case TraceEvent::Flip:
+			return "flip";
+		case TraceEvent::ValidationFailed:
+			return "validationFailed";
+		default:
+			return "unknown";
+	}
+}
+
+int main( int argc, char *argv[] )
+{
+	if ( argc != 2 ) {
+		std::fprintf( stderr, "Usage: %s TRACE_FILE\n", argv[0] );
+		return 1;
+	}
+	std::FILE *file = std::fopen( argv[1], "rb" );
+	if ( !file ) {
+		std::perror( argv[1] );
+		return 1;
+	}
+	TraceRecord record{};
+	while ( std::fread( &record, sizeof( record ), 1, file ) == 1 ) {
+		std::printf( "%s %llu %llu %llu %g %g\n", eventName( record.event ), static_cast<unsigned long long>( record.a ), static_cast<unsigned long long>( record.b ),
+					 static_cast<unsigned long long>( record.c ), record.x, record.y );
+	}
+	std::fclose( file );
+	return 0;
+}
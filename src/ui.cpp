@@ -1,11 +1,17 @@
 #include "ui.h"
-#include "algo.h"
+#include <QFileDialog>
+#include <QFontDatabase>
+#include <QFutureWatcher>
 #include <QHBoxLayout>
 #include <QLabel>
 #include <QLineEdit>
+#include <QMessageBox>
 #include <QPushButton>
 #include <QValidator>
+#include <QtConcurrent>
+#include <algorithm>
 #include <array>
+#include <fstream>
 
 MainUI::MainUI()
 {
@@ -31,10 +37,26 @@ MainUI::MainUI()
 
 	auto *confirmButton = new QPushButton{ "Generate" };
 	connect( confirmButton, &QAbstractButton::clicked, this, &MainUI::generate );
+	cancelButton = new QPushButton{ "Cancel" };
+	cancelButton->setEnabled( false );
+	connect( cancelButton, &QAbstractButton::clicked, this, &MainUI::cancel );
+	progressBar = new QProgressBar;
+	progressBar->setRange( 0, 100 );
+	progressBar->setVisible( false );
+	statsView = new QPlainTextEdit;
+	statsView->setReadOnly( true );
+	statsView->setLineWrapMode( QPlainTextEdit::NoWrap );
+	statsView->setFont( QFontDatabase::systemFont( QFontDatabase::FixedFont ) );
+	exportButton = new QPushButton{ "Export trace..." };
+	exportButton->setEnabled( false );
+	connect( exportButton, &QAbstractButton::clicked, this, &MainUI::exportTrace );
 
 	leftLayout->addWidget( inputPanel );
-	leftLayout->addStretch();
+	leftLayout->addWidget( statsView, 1 );
+	leftLayout->addWidget( exportButton );
+	leftLayout->addWidget( progressBar );
 	leftLayout->addWidget( confirmButton );
+	leftLayout->addWidget( cancelButton );
 	leftPanel->setLayout( leftLayout );
 
 	graphRender = new GraphRender;
@@ -45,6 +67,18 @@ MainUI::MainUI()
 	setLayout( mainLayout );
 }
 
+MainUI::~MainUI()
+{
+	cancel();
+	// Jobs of this window report progress to it until they return, cancelled ones included. Only those are waited
+	// for, other users of the global pool are left alone.
+	for ( auto *watcher : watchers ) {
+		watcher->waitForFinished();
+	}
+}
+
+// Generation, triangulation and routing run on the thread pool. Progress is reported from the worker thread and
+// shown through queued calls; the result comes back through a future watcher.
 void MainUI::generate()
 {
 	int numbers[4];
@@ -53,7 +87,104 @@ void MainUI::generate()
 			return;
 		}
 	}
-	auto graph = generateRandomGraph( numbers[0], numbers[1], numbers[2], numbers[3] );
-	constructCDT( graph );
-	graphRender->onGraphChanged( graph );
+	cancel();
+	unsigned id = job_id;
+	auto control = job = std::make_shared<JobControl>( [this, id]( const char *stage, double fraction ) {
+		QString name( stage );
+		int percent = fraction * 100;
+		QMetaObject::invokeMethod(
+			this,
+			[this, id, name, percent] {
+				if ( id == job_id ) {
+					showProgress( name, percent );
+				}
+			},
+			Qt::QueuedConnection );
+	} );
+	auto *watcher = new QFutureWatcher<JobResult>( this );
+	watchers.push_back( watcher );
+	connect( watcher, &QFutureWatcherBase::finished, this, [this, watcher, id] {
+		watchers.erase( std::find( watchers.begin(), watchers.end(), watcher ) );
+		finish( id, watcher->result() );
+		watcher->deleteLater();
+	} );
+	watcher->setFuture( QtConcurrent::run( [control, numbers = std::array{ numbers[0], numbers[1], numbers[2], numbers[3] }] {
+		GenerateOptions generateOptions;
+		generateOptions.control = control.get();
+		JobResult result;
+		result.graph.reset( generateRandomGraph( numbers[0], numbers[1], numbers[2], numbers[3], std::random_device{}(), generateOptions ) );
+		RouteOptions routeOptions;
+		routeOptions.control = control.get();
+		if ( result.graph == nullptr || !routeNets( result.graph.get(), &result.stats, routeOptions ) ) {
+			result.graph.reset();
+		}
+		return result;
+	} ) );
+	showProgress( "generating", 0 );
+	progressBar->setVisible( true );
+	cancelButton->setEnabled( true );
+}
+
+void MainUI::cancel()
+{
+	if ( job ) {
+		job->cancel();
+		job.reset();
+	}
+	++job_id;
+	progressBar->setVisible( false );
+	cancelButton->setEnabled( false );
+}
+
+void MainUI::showProgress( const QString &stage, int percent )
+{
+	progressBar->setFormat( stage + " %p%" );
+	progressBar->setValue( percent );
+}
+
+void MainUI::finish( unsigned id, JobResult result )
+{
+	// Results of cancelled or replaced jobs are dropped, and so are their graphs
+	if ( id != job_id ) {
+		return;
+	}
+	job.reset();
+	progressBar->setVisible( false );
+	cancelButton->setEnabled( false );
+	if ( result.graph ) {
+		graphRender->onGraphChanged( std::move( result.graph ) );
+		stats = std::move( result.stats );
+		showStats();
+	}
+}
+
+void MainUI::showStats()
+{
+	const auto &cdt = stats.cdt;
+	QString text = QString( "nodes %1, triangles %2\n" ).arg( cdt.nodes ).arg( cdt.triangles );
+	for ( size_t i = 0; i < cdt.phases.size(); ++i ) {
+		text += QString( "%1 %2 ms\n" ).arg( QString( phaseName( static_cast<CDTPhase>( i ) ) ), -14 ).arg( cdt.phases[i].seconds * 1e3, 9, 'f', 2 );
+	}
+	text += QString( "%1 %2 ms\n" ).arg( QString( "routing" ), -14 ).arg( stats.seconds * 1e3, 9, 'f', 2 );
+	for ( size_t i = 0; i < cdt.profile.counters.size(); ++i ) {
+		text += QString( "%1 %2\n" ).arg( QString( counterName( static_cast<Counter>( i ) ) ), -14 ).arg( cdt.profile.counters[i], 12 );
+	}
+	text += QString( "routed %1, unrouted %2, overflow edges %3" ).arg( stats.routed ).arg( stats.unrouted ).arg( stats.overflowEdges );
+	statsView->setPlainText( text );
+	exportButton->setEnabled( true );
+}
+
+void MainUI::exportTrace()
+{
+	QString path = QFileDialog::getSaveFileName( this, "Export trace", "trace.json", "Chrome trace (*.json)" );
+	if ( path.isEmpty() ) {
+		return;
+	}
+	std::ofstream out( path.toStdString() );
+	if ( out ) {
+		writeChromeTrace( out, { { "route", &stats.cdt.profile } } );
+	}
+	if ( !out ) {
+		QMessageBox::warning( this, "Export trace", "Cannot write " + path );
+	}
 }
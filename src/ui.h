@@ -1,18 +1,51 @@
 #pragma once
+#include "algo.h"
 #include "graphrender.h"
+#include "job.h"
 #include <QLineEdit>
+#include <QFutureWatcher>
 #include <QMainWindow>
+#include <QPlainTextEdit>
+#include <QProgressBar>
+#include <QPushButton>
+#include <memory>
+#include <vector>
+
+// What a job hands back to the GUI thread; graph is null when it was cancelled
+struct JobResult {
+	std::shared_ptr<Graph> graph;
+	RouteStats stats;
+};
 
 class MainUI : public QWidget
 {
 	Q_OBJECT
 public:
 	MainUI();
+	// Cancels the running job and waits for every job this window started
+	~MainUI() override;
 private slots:
 	void generate();
+	void cancel();
+	void exportTrace();
 
 private:
 	// width, height, obstacle count, net count
 	QLineEdit *inputs[4];
 	GraphRender *graphRender;
-};
\ No newline at end of file
+	QProgressBar *progressBar;
+	QPushButton *cancelButton;
+	// Phase times and counters of the last finished job, which the trace export writes out
+	QPlainTextEdit *statsView;
+	QPushButton *exportButton;
+	RouteStats stats;
+	// Control of the running job, null when idle. Starting a job cancels the previous one; progress and results
+	// only count while their id is the current one.
+	std::shared_ptr<JobControl> job;
+	unsigned job_id = 0;
+	// Watchers of the jobs still running, cancelled ones included
+	std::vector<QFutureWatcher<JobResult> *> watchers;
+	void showProgress( const QString &stage, int percent );
+	void finish( unsigned id, JobResult result );
+	void showStats();
+};
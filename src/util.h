@@ -1,41 +1,261 @@
 #pragma once
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <random>
+#include <sys/resource.h>
+#include <thread>
+#include <vector>
+
+// Well mixed 64 bits from a counter
+inline uint64_t splitMix64( uint64_t x )
+{
+	x += 0x9e3779b97f4a7c15ull;
+	x = ( x ^ ( x >> 30 ) ) * 0xbf58476d1ce4e5b9ull;
+	x = ( x ^ ( x >> 27 ) ) * 0x94d049bb133111ebull;
+	return x ^ ( x >> 31 );
+}
+
+// Seeded xoshiro256** generator, run as lanes independent generators side by side so that a block of lanes
+// samples is one vectorizable loop. Single samples are served from the last block, so any mix of single draws and
+// fills yields the same sequence for a seed. Under 200 bytes, cheap to create one per thread or per region.
+class RandomStream
+{
+public:
+	static constexpr size_t lanes = 4;
+
+	explicit RandomStream( uint64_t seed ) : key( seed )
+	{
+		// splitmix64 of the seed fills the states, as the xoshiro authors recommend
+		uint64_t x = seed;
+		for ( auto &word : state ) {
+			for ( auto &lane : word ) {
+				lane = splitMix64( x );
+				x += 0x9e3779b97f4a7c15ull;
+			}
+		}
+	}
+	// Stream index of this seed, independent of the stream itself and of every other index
+	RandomStream split( uint64_t index ) const
+	{
+		return RandomStream( splitMix64( key ^ splitMix64( index ) ) );
+	}
+	// The next lanes raw samples
+	void nextBlock( uint64_t *out )
+	{
+		auto &[s0, s1, s2, s3] = state;
+		for ( size_t l = 0; l < lanes; ++l ) {
+			out[l] = rotl( s1[l] * 5, 7 ) * 9;
+			uint64_t t = s1[l] << 17;
+			s2[l] ^= s0[l];
+			s3[l] ^= s1[l];
+			s1[l] ^= s2[l];
+			s0[l] ^= s3[l];
+			s2[l] ^= t;
+			s3[l] = rotl( s3[l], 45 );
+		}
+	}
+	uint64_t next()
+	{
+		if ( used == lanes ) {
+			nextBlock( buffer );
+			used = 0;
+		}
+		return buffer[used++];
+	}
+	// Uniform in [0, 1) from the top 53 bits
+	static double unit( uint64_t x ) { return ( x >> 11 ) * 0x1.0p-53; }
+	// Count samples uniform in [min, max), the same as count calls of min + unit( next() ) * ( max - min )
+	void fillUniform( double *out, size_t count, double min, double max )
+	{
+		double scale = max - min;
+		size_t i = 0;
+		for ( ; i < count && used < lanes; ++i ) {
+			out[i] = min + unit( buffer[used++] ) * scale;
+		}
+		for ( ; i + lanes <= count; i += lanes ) {
+			uint64_t block[lanes];
+			nextBlock( block );
+			for ( size_t l = 0; l < lanes; ++l ) {
+				out[i + l] = min + unit( block[l] ) * scale;
+			}
+		}
+		for ( ; i < count; ++i ) {
+			out[i] = min + unit( next() ) * scale;
+		}
+	}
+
+private:
+	static uint64_t rotl( uint64_t x, int k ) { return ( x << k ) | ( x >> ( 64 - k ) ); }
+
+	uint64_t key;
+	std::array<std::array<uint64_t, lanes>, 4> state;
+	uint64_t buffer[lanes];
+	size_t used = lanes;
+};
 
 class RandomUniformReal
 {
 public:
-	RandomUniformReal( double randomMin, double randomMax ) : rd(), gen( rd() ), dis( randomMin, randomMax ) {}
+	RandomUniformReal( double randomMin, double randomMax ) : RandomUniformReal( randomMin, randomMax, std::random_device{}() ) {}
+	RandomUniformReal( double randomMin, double randomMax, uint64_t seed ) : RandomUniformReal( randomMin, randomMax, RandomStream( seed ) ) {}
+	RandomUniformReal( double randomMin, double randomMax, const RandomStream &stream ) : min( randomMin ), max( randomMax ), stream( stream ) {}
 	double operator()()
 	{
-		return dis( gen );
+		return min + RandomStream::unit( stream.next() ) * ( max - min );
+	}
+	// The next count samples, the same as count calls
+	void fill( double *out, size_t count )
+	{
+		stream.fillUniform( out, count, min, max );
 	}
 
 private:
-	std::random_device rd;
-	std::mt19937 gen;
-	std::uniform_real_distribution<> dis;
+	double min, max;
+	RandomStream stream;
 };
 
+// Normal samples centered in [min, max] with a standard deviation of a sixth of it, truncated to the range. Box-Muller
+// turns a block of uniform pairs into a block of normals at once, and the 0.3% beyond three deviations are dropped
+// from the block rather than redrawn one by one.
 class RandomNormalReal
 {
 public:
-	RandomNormalReal( double randomMin, double randomMax ) : min( randomMin ), max( randomMax ), radius( ( max - min ) / 6 ), center( ( max + min ) / 2 ), rd(), gen( rd() ), dis() {}
+	RandomNormalReal( double randomMin, double randomMax ) : RandomNormalReal( randomMin, randomMax, std::random_device{}() ) {}
+	RandomNormalReal( double randomMin, double randomMax, uint64_t seed ) : RandomNormalReal( randomMin, randomMax, RandomStream( seed ) ) {}
+	RandomNormalReal( double randomMin, double randomMax, const RandomStream &stream )
+		: min( randomMin ), max( randomMax ), radius( ( max - min ) / 6 ), center( ( max + min ) / 2 ), stream( stream )
+	{
+	}
 	double operator()()
 	{
-		double x;
-		do {
-			x = center + dis( gen ) * radius;
-		} while ( x < min || x > max );
-		return x;
+		while ( used == kept ) {
+			kept = nextBlock( buffer ), used = 0;
+		}
+		return buffer[used++];
+	}
+	// The next count samples, the same as count calls
+	void fill( double *out, size_t count )
+	{
+		size_t i = 0;
+		for ( ; i < count && used < kept; ++i ) {
+			out[i] = buffer[used++];
+		}
+		while ( i + block <= count ) {
+			i += nextBlock( out + i );
+		}
+		while ( i < count ) {
+			out[i++] = ( *this )();
+		}
 	}
 
 private:
+	static constexpr size_t block = 2 * RandomStream::lanes;
+
+	// Fills out with up to block samples, returns how many were kept
+	size_t nextBlock( double *out )
+	{
+		uint64_t bits[block];
+		stream.nextBlock( bits );
+		stream.nextBlock( bits + RandomStream::lanes );
+		double samples[block];
+		for ( size_t l = 0; l < RandomStream::lanes; ++l ) {
+			// 1 - unit is in (0, 1], so the logarithm is finite
+			double r = std::sqrt( -2 * std::log( 1 - RandomStream::unit( bits[l] ) ) ) * radius;
+			double a = 6.283185307179586 * RandomStream::unit( bits[l + RandomStream::lanes] );
+			samples[2 * l] = center + r * std::cos( a );
+			samples[2 * l + 1] = center + r * std::sin( a );
+		}
+		size_t count = 0;
+		for ( double x : samples ) {
+			out[count] = x;
+			count += x >= min && x <= max;
+		}
+		return count;
+	}
+
 	double min, max, radius, center;
-	std::random_device rd;
-	std::mt19937 gen;
-	std::normal_distribution<> dis;
+	RandomStream stream;
+	double buffer[block];
+	size_t used = 0, kept = 0;
 };
 
+// Peak resident set size of this process in KiB
+inline long peakRssKb()
+{
+	rusage usage{};
+	getrusage( RUSAGE_SELF, &usage );
+	return usage.ru_maxrss;
+}
+
+// Wall clock stopwatch
+class Stopwatch
+{
+public:
+	Stopwatch() : start( std::chrono::steady_clock::now() ) {}
+	double elapsed() const
+	{
+		return std::chrono::duration<double>( std::chrono::steady_clock::now() - start ).count();
+	}
+	double lap()
+	{
+		auto now = std::chrono::steady_clock::now();
+		double seconds = std::chrono::duration<double>( now - start ).count();
+		start = now;
+		return seconds;
+	}
+
+private:
+	std::chrono::steady_clock::time_point start;
+};
+
+// Run body( begin, end ) over [0, count) split into `threads` contiguous chunks, one thread per chunk
+template<typename Body>
+void parallelFor( unsigned threads, size_t count, Body body )
+{
+	threads = std::max<size_t>( 1, std::min<size_t>( threads, count ) );
+	if ( threads == 1 ) {
+		body( size_t( 0 ), count );
+		return;
+	}
+	std::vector<std::thread> workers;
+	workers.reserve( threads );
+	for ( unsigned k = 0; k < threads; ++k ) {
+		workers.emplace_back( body, count * k / threads, count * ( k + 1 ) / threads );
+	}
+	for ( auto &worker : workers ) {
+		worker.join();
+	}
+}
+
+// Run body( worker, begin, end ) over [0, count) on `threads` threads. Each thread keeps claiming the next `grain`
+// items until none are left, so items of uneven cost still spread evenly. worker is the thread index in [0, threads).
+template<typename Body>
+void parallelForDynamic( unsigned threads, size_t count, size_t grain, Body body )
+{
+	grain = std::max<size_t>( 1, grain );
+	threads = std::max<size_t>( 1, std::min<size_t>( threads, ( count + grain - 1 ) / grain ) );
+	std::atomic<size_t> next{ 0 };
+	auto work = [&]( unsigned worker ) {
+		for ( size_t begin; ( begin = next.fetch_add( grain, std::memory_order_relaxed ) ) < count; ) {
+			body( worker, begin, std::min( begin + grain, count ) );
+		}
+	};
+	std::vector<std::thread> workers;
+	workers.reserve( threads - 1 );
+	for ( unsigned k = 1; k < threads; ++k ) {
+		workers.emplace_back( work, k );
+	}
+	work( 0 );
+	for ( auto &worker : workers ) {
+		worker.join();
+	}
+}
+
 // Multi-dimensional array
 template<typename T, size_t size, size_t... sizeOthers>
 class MDArray
@@ -60,39 +280,3 @@ public:
 		return data[idx];
 	}
 };
-
-template<typename T>
-class DynamicMDArray
-{
-	T *data;
-	size_t tsize, dim, *dsize;
-
-public:
-	explicit DynamicMDArray( std::initializer_list<size_t> size )
-	{
-		dim = size.size();
-		dsize = new size_t[dim];
-		std::copy( size.begin(), size.end(), dsize );
-		tsize = 1;
-		for ( int i = dim - 1; i >= 0; i-- ) {
-			size_t ss = tsize * dsize[i];
-			dsize[i] = tsize;
-			tsize = ss;
-		}
-		data = new T[tsize];
-	}
-	~DynamicMDArray()
-	{
-		delete[] data;
-		delete[] dsize;
-	}
-	T &at( std::initializer_list<size_t> pos )
-	{
-		assert( dim == pos.size() );
-		size_t idx = 0, i = 0;
-		for ( unsigned long po : pos ) {
-			idx += po * dsize[i++];
-		}
-		return data[idx];
-	}
-};
\ No newline at end of file
@@ -0,0 +1,402 @@
+#include "graph.h"
+#include "geometry.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <numeric>
+#include <tuple>
+#include <vector>
+
+const char *issueName( GraphIssue::Kind kind )
+{
+	switch ( kind ) {
+		case GraphIssue::Kind::ObstacleOutOfBounds:
+			return "obstacleOutOfBounds";
+		case GraphIssue::Kind::EmptyObstacle:
+			return "emptyObstacle";
+		case GraphIssue::Kind::OverlappingObstacles:
+			return "overlappingObstacles";
+		case GraphIssue::Kind::PinOutOfBounds:
+			return "pinOutOfBounds";
+		case GraphIssue::Kind::PinInsideObstacle:
+			return "pinInsideObstacle";
+		case GraphIssue::Kind::PinOnObstacle:
+			return "pinOnObstacle";
+		case GraphIssue::Kind::DegenerateNet:
+			return "degenerateNet";
+		case GraphIssue::Kind::DuplicateNet:
+			return "duplicateNet";
+		default:
+			return "unknown";
+	}
+}
+
+namespace
+{
+	Rect toRect( const TwoPoints &obstacle )
+	{
+		auto [p1, p2] = obstacle;
+		return { std::get<0>( p1 ), std::get<1>( p1 ), std::get<0>( p2 ), std::get<1>( p2 ) };
+	}
+	bool isEmpty( const Rect &r )
+	{
+		// Written so that NaN corners count as empty
+		return !( r.x2 > r.x1 ) || !( r.y2 > r.y1 );
+	}
+	bool inside( double x, double y, double width, double height )
+	{
+		return x >= 0 && x <= width && y >= 0 && y <= height;
+	}
+	Point pin( const std::vector<TwoPoints> &nets, int p )
+	{
+		return p % 2 ? std::get<1>( nets[p / 2] ) : std::get<0>( nets[p / 2] );
+	}
+
+	// Open obstacles of a sweep along x. Leaves are the obstacles ranked by y1 and hold y2 while the obstacle is
+	// open, inner nodes the largest y2 below them, so the open obstacles whose y range reaches past a bound are
+	// found without looking at the others.
+	class SweepTree
+	{
+	public:
+		explicit SweepTree( const std::vector<Rect> &rects, const std::vector<int> &items ) : rects( rects )
+		{
+			byY1 = items;
+			std::sort( byY1.begin(), byY1.end(), [&]( int a, int b ) { return std::tie( rects[a].y1, a ) < std::tie( rects[b].y1, b ); } );
+			rank.assign( rects.size(), 0 );
+			y1.resize( byY1.size() );
+			for ( size_t r = 0; r < byY1.size(); ++r ) {
+				rank[byY1[r]] = r;
+				y1[r] = rects[byY1[r]].y1;
+			}
+			for ( leaves = 1; leaves < byY1.size(); leaves *= 2 ) {
+			}
+			top.assign( 2 * leaves, closed );
+		}
+		void open( int item ) { set( rank[item], rects[item].y2 ); }
+		void close( int item ) { set( rank[item], closed ); }
+		// visit( item ) for every open obstacle with y1 < y2Bound and y2 > y1Bound, or y1 <= y2Bound and
+		// y2 >= y1Bound when closedRange is set
+		template<typename Visit>
+		void query( double y1Bound, double y2Bound, bool closedRange, Visit visit ) const
+		{
+			size_t end = ( closedRange ? std::upper_bound( y1.begin(), y1.end(), y2Bound ) : std::lower_bound( y1.begin(), y1.end(), y2Bound ) ) - y1.begin();
+			descend( 1, 0, leaves, end, y1Bound, closedRange, visit );
+		}
+
+	private:
+		static constexpr double closed = -std::numeric_limits<double>::infinity();
+		void set( size_t leaf, double value )
+		{
+			size_t node = leaves + leaf;
+			top[node] = value;
+			for ( node /= 2; node > 0; node /= 2 ) {
+				top[node] = std::max( top[2 * node], top[2 * node + 1] );
+			}
+		}
+		template<typename Visit>
+		void descend( size_t node, size_t begin, size_t end, size_t limit, double bound, bool closedRange, Visit &visit ) const
+		{
+			if ( begin >= limit || !( closedRange ? top[node] >= bound : top[node] > bound ) ) {
+				return;
+			}
+			if ( end - begin == 1 ) {
+				visit( byY1[begin] );
+				return;
+			}
+			size_t middle = ( begin + end ) / 2;
+			descend( 2 * node, begin, middle, limit, bound, closedRange, visit );
+			descend( 2 * node + 1, middle, end, limit, bound, closedRange, visit );
+		}
+
+		const std::vector<Rect> &rects;
+		std::vector<int> byY1;
+		std::vector<size_t> rank;
+		std::vector<double> y1;
+		std::vector<double> top;
+		size_t leaves;
+	};
+
+	// visit( a, b ) for every pair of the given obstacles whose interiors intersect, a opened before b.
+	// Obstacles closing at an x are closed before those opening there, so sides in common do not count.
+	template<typename Visit>
+	void overlappingPairs( const std::vector<Rect> &rects, const std::vector<int> &items, Visit visit )
+	{
+		// ( x, opening, item )
+		std::vector<std::tuple<double, bool, int>> events;
+		events.reserve( 2 * items.size() );
+		for ( int i : items ) {
+			events.emplace_back( rects[i].x1, true, i );
+			events.emplace_back( rects[i].x2, false, i );
+		}
+		std::sort( events.begin(), events.end() );
+		SweepTree tree( rects, items );
+		for ( auto [x, opening, i] : events ) {
+			if ( !opening ) {
+				tree.close( i );
+				continue;
+			}
+			tree.query( rects[i].y1, rects[i].y2, false, [&]( int other ) { visit( other, i ); } );
+			tree.open( i );
+		}
+	}
+
+	// visit( p, obstacle, strictly ) for every pin p of the given ones in the closure of one of the given obstacles
+	template<typename Visit>
+	void pinsInObstacles( const std::vector<Rect> &rects, const std::vector<int> &items, const std::vector<TwoPoints> &nets, const std::vector<int> &pins, Visit visit )
+	{
+		// ( x, order, item ): obstacles open before and close after the pins at the same x
+		std::vector<std::tuple<double, int, int>> events;
+		events.reserve( 2 * items.size() + pins.size() );
+		for ( int i : items ) {
+			events.emplace_back( rects[i].x1, 0, i );
+			events.emplace_back( rects[i].x2, 2, i );
+		}
+		for ( int p : pins ) {
+			events.emplace_back( std::get<0>( pin( nets, p ) ), 1, p );
+		}
+		std::sort( events.begin(), events.end() );
+		SweepTree tree( rects, items );
+		for ( auto [x, order, i] : events ) {
+			if ( order == 0 ) {
+				tree.open( i );
+			} else if ( order == 2 ) {
+				tree.close( i );
+			} else {
+				double y = std::get<1>( pin( nets, i ) );
+				tree.query( y, y, true, [&]( int obstacle ) {
+					const auto &r = rects[obstacle];
+					visit( i, obstacle, r.contains( x, y ) );
+				} );
+			}
+		}
+	}
+
+	// Items whose geometry the sweeps can take: non-empty obstacles and pins that are numbers
+	std::vector<int> sweepObstacles( const std::vector<Rect> &rects )
+	{
+		std::vector<int> items;
+		for ( size_t i = 0; i < rects.size(); ++i ) {
+			if ( !isEmpty( rects[i] ) ) {
+				items.push_back( i );
+			}
+		}
+		return items;
+	}
+	std::vector<int> sweepPins( const std::vector<TwoPoints> &nets )
+	{
+		std::vector<int> pins;
+		for ( size_t p = 0; p < 2 * nets.size(); ++p ) {
+			auto [x, y] = pin( nets, p );
+			if ( !std::isnan( x ) && !std::isnan( y ) ) {
+				pins.push_back( p );
+			}
+		}
+		return pins;
+	}
+
+	// Index of every net whose unordered pins match an earlier net
+	template<typename Visit>
+	void duplicateNets( const std::vector<TwoPoints> &nets, Visit visit )
+	{
+		auto key = [&]( int n ) {
+			auto [p1, p2] = nets[n];
+			return std::make_tuple( std::min( p1, p2 ), std::max( p1, p2 ), n );
+		};
+		std::vector<int> order( nets.size() );
+		std::iota( order.begin(), order.end(), 0 );
+		std::sort( order.begin(), order.end(), [&]( int a, int b ) { return key( a ) < key( b ); } );
+		for ( size_t k = 1; k < order.size(); ++k ) {
+			auto [a1, a2, a] = key( order[k - 1] );
+			auto [b1, b2, b] = key( order[k] );
+			if ( a1 == b1 && a2 == b2 ) {
+				visit( b, a );
+			}
+		}
+	}
+} // namespace
+
+GraphReport validateGraph( const Graph &graph, size_t maxIssues )
+{
+	GraphReport report;
+	auto add = [&]( GraphIssue::Kind kind, int item, int other ) {
+		++report.counts[static_cast<size_t>( kind )];
+		if ( report.issues.size() < maxIssues ) {
+			report.issues.push_back( { kind, item, other } );
+		}
+	};
+	double width = graph.getWidth(), height = graph.getHeight();
+	const auto &obstacles = graph.getObstacles();
+	const auto &nets = graph.getNets();
+
+	std::vector<Rect> rects;
+	rects.reserve( obstacles.size() );
+	for ( size_t i = 0; i < obstacles.size(); ++i ) {
+		rects.push_back( toRect( obstacles[i] ) );
+		const auto &r = rects.back();
+		if ( !inside( r.x1, r.y1, width, height ) || !inside( r.x2, r.y2, width, height ) ) {
+			add( GraphIssue::Kind::ObstacleOutOfBounds, i, -1 );
+		}
+		if ( isEmpty( r ) ) {
+			add( GraphIssue::Kind::EmptyObstacle, i, -1 );
+		}
+	}
+	auto items = sweepObstacles( rects );
+	overlappingPairs( rects, items, [&]( int a, int b ) { add( GraphIssue::Kind::OverlappingObstacles, std::min( a, b ), std::max( a, b ) ); } );
+
+	for ( size_t p = 0; p < 2 * nets.size(); ++p ) {
+		auto [x, y] = pin( nets, p );
+		if ( !inside( x, y, width, height ) ) {
+			add( GraphIssue::Kind::PinOutOfBounds, p, -1 );
+		}
+	}
+	pinsInObstacles( rects, items, nets, sweepPins( nets ), [&]( int p, int obstacle, bool strictly ) {
+		add( strictly ? GraphIssue::Kind::PinInsideObstacle : GraphIssue::Kind::PinOnObstacle, p, obstacle );
+	} );
+	for ( size_t n = 0; n < nets.size(); ++n ) {
+		if ( std::get<0>( nets[n] ) == std::get<1>( nets[n] ) ) {
+			add( GraphIssue::Kind::DegenerateNet, n, -1 );
+		}
+	}
+	duplicateNets( nets, [&]( int net, int earlier ) { add( GraphIssue::Kind::DuplicateNet, net, earlier ); } );
+	return report;
+}
+
+Graph *repairGraph( const Graph &graph, RepairStats *stats )
+{
+	RepairStats local;
+	auto &counts = stats ? *stats : local;
+	counts = {};
+	double width = graph.getWidth(), height = graph.getHeight();
+
+	// Obstacles: clip to the die, then merge overlapping groups into their bounding box. A box can reach obstacles
+	// its parts did not, so this repeats until a sweep finds nothing; every round that merges has fewer obstacles.
+	std::vector<Rect> rects;
+	for ( const auto &obstacle : graph.getObstacles() ) {
+		Rect r = toRect( obstacle );
+		Rect clipped{ std::clamp( r.x1, 0.0, width ), std::clamp( r.y1, 0.0, height ), std::clamp( r.x2, 0.0, width ), std::clamp( r.y2, 0.0, height ) };
+		if ( isEmpty( clipped ) ) {
+			++counts.droppedObstacles;
+			continue;
+		}
+		if ( clipped.x1 != r.x1 || clipped.y1 != r.y1 || clipped.x2 != r.x2 || clipped.y2 != r.y2 ) {
+			++counts.clampedObstacles;
+		}
+		rects.push_back( clipped );
+	}
+	for ( bool merged = true; merged; ) {
+		std::vector<int> parent( rects.size() );
+		std::iota( parent.begin(), parent.end(), 0 );
+		auto find = [&]( int i ) {
+			while ( parent[i] != i ) {
+				i = parent[i] = parent[parent[i]];
+			}
+			return i;
+		};
+		std::vector<int> items( rects.size() );
+		std::iota( items.begin(), items.end(), 0 );
+		merged = false;
+		overlappingPairs( rects, items, [&]( int a, int b ) {
+			a = find( a ), b = find( b );
+			if ( a != b ) {
+				parent[std::max( a, b )] = std::min( a, b );
+				merged = true;
+			}
+		} );
+		if ( !merged ) {
+			break;
+		}
+		// Roots come before their members, so every box is complete when it is moved to its new index
+		std::vector<Rect> boxes;
+		std::vector<int> index( rects.size(), -1 );
+		for ( size_t i = 0; i < rects.size(); ++i ) {
+			int root = find( i );
+			if ( root == static_cast<int>( i ) ) {
+				index[i] = boxes.size();
+				boxes.push_back( rects[i] );
+				continue;
+			}
+			auto &box = boxes[index[root]];
+			box = { std::min( box.x1, rects[i].x1 ), std::min( box.y1, rects[i].y1 ), std::max( box.x2, rects[i].x2 ), std::max( box.y2, rects[i].y2 ) };
+			++counts.mergedObstacles;
+		}
+		rects.swap( boxes );
+	}
+	std::vector<int> items( rects.size() );
+	std::iota( items.begin(), items.end(), 0 );
+
+	// Pins: clamp to the die, then move blocked pins one representable step past the nearest side of the obstacle
+	// that has room. A move can land on a neighbouring obstacle, so this repeats a few times before giving up.
+	std::vector<TwoPoints> nets;
+	for ( auto [p1, p2] : graph.getNets() ) {
+		bool numbers = true;
+		for ( auto *p : { &p1, &p2 } ) {
+			auto &[x, y] = *p;
+			numbers = numbers && !std::isnan( x ) && !std::isnan( y );
+			if ( numbers && !inside( x, y, width, height ) ) {
+				x = std::clamp( x, 0.0, width ), y = std::clamp( y, 0.0, height );
+				++counts.clampedPins;
+			}
+		}
+		if ( numbers ) {
+			nets.emplace_back( p1, p2 );
+		} else {
+			++counts.droppedNets;
+		}
+	}
+	constexpr int moveRounds = 4;
+	std::vector<bool> blocked;
+	for ( int round = 0; round <= moveRounds; ++round ) {
+		blocked.assign( 2 * nets.size(), false );
+		std::vector<int> pins( 2 * nets.size() );
+		std::iota( pins.begin(), pins.end(), 0 );
+		std::vector<std::tuple<int, int>> hits;
+		pinsInObstacles( rects, items, nets, pins, [&]( int p, int obstacle, bool ) { hits.emplace_back( p, obstacle ); } );
+		if ( hits.empty() || round == moveRounds ) {
+			for ( auto [p, obstacle] : hits ) {
+				blocked[p] = true;
+			}
+			break;
+		}
+		for ( auto [p, obstacle] : hits ) {
+			if ( blocked[p] ) {
+				continue;
+			}
+			blocked[p] = true;
+			auto &[x, y] = p % 2 ? std::get<1>( nets[p / 2] ) : std::get<0>( nets[p / 2] );
+			const auto &r = rects[obstacle];
+			constexpr double inf = std::numeric_limits<double>::infinity();
+			std::tuple<double, double, double> candidates[] = { { x - r.x1, std::nextafter( r.x1, -inf ), y },
+																 { r.x2 - x, std::nextafter( r.x2, inf ), y },
+																 { y - r.y1, x, std::nextafter( r.y1, -inf ) },
+																 { r.y2 - y, x, std::nextafter( r.y2, inf ) } };
+			std::sort( std::begin( candidates ), std::end( candidates ) );
+			for ( auto [distance, cx, cy] : candidates ) {
+				if ( inside( cx, cy, width, height ) ) {
+					x = cx, y = cy;
+					++counts.movedPins;
+					break;
+				}
+			}
+		}
+	}
+
+	// Drop blocked, degenerate and duplicate nets, keeping the order of the others
+	std::vector<bool> drop( nets.size(), false );
+	for ( size_t n = 0; n < nets.size(); ++n ) {
+		drop[n] = blocked[2 * n] || blocked[2 * n + 1] || std::get<0>( nets[n] ) == std::get<1>( nets[n] );
+	}
+	duplicateNets( nets, [&]( int net, int ) { drop[net] = true; } );
+	std::vector<TwoPoints> kept, obstacles;
+	for ( size_t n = 0; n < nets.size(); ++n ) {
+		if ( drop[n] ) {
+			++counts.droppedNets;
+		} else {
+			kept.push_back( nets[n] );
+		}
+	}
+	obstacles.reserve( rects.size() );
+	for ( const auto &r : rects ) {
+		obstacles.push_back( { { r.x1, r.y1 }, { r.x2, r.y2 } } );
+	}
+	return new Graph( width, height, std::move( obstacles ), std::move( kept ) );
+}
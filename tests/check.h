@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+#include <iostream>
+
+// Checks of the regression tests. They stay on in release builds; a failed check is reported and the test exits
+// with 1 once it is done, see checkFailures.
+inline int &checkFailures()
+{
+	static int failures = 0;
+	return failures;
+}
+
+#define CHECK( condition ) \
+	do { \
+		if ( !( condition ) ) { \
+			std::cerr << __FILE__ << ":" << __LINE__ << ": check failed: " << #condition << "\n"; \
+			++checkFailures(); \
+		} \
+	} while ( false )
+
+// Small deterministic generator, so test inputs do not depend on the standard library
+struct TestRandom {
+	uint64_t state;
+
+	uint64_t next()
+	{
+		state = state * 6364136223846793005ull + 1442695040888963407ull;
+		return state >> 11;
+	}
+	// Uniform in [0, 1)
+	double uniform() { return next() * ( 1.0 / ( 1ull << 53 ) ); }
+};
@@ -0,0 +1,249 @@
+// The daemon protocol: frame coding, then a real aarf_daemon, whose path is the first argument, answering batches
+// from two clients
+#include "check.h"
+#include "protocol.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <thread>
+#include <vector>
+
+static void testFrames()
+{
+	FrameWriter writer;
+	writer.put( uint8_t( 7 ) );
+	writer.put( 1.5 );
+	writer.put( uint32_t( 42 ) );
+	FrameReader reader{ writer.bytes.data(), writer.bytes.data() + writer.bytes.size() };
+	uint8_t op;
+	double value;
+	uint32_t count;
+	CHECK( reader.get( op ) && op == 7 );
+	CHECK( reader.remaining() == sizeof( double ) + sizeof( uint32_t ) );
+	CHECK( reader.get( value ) && value == 1.5 );
+	// Too short for a double, and nothing is consumed
+	CHECK( !reader.get( value ) );
+	CHECK( reader.get( count ) && count == 42 );
+	CHECK( reader.done() );
+
+	int fds[2];
+	CHECK( socketpair( AF_UNIX, SOCK_STREAM, 0, fds ) == 0 );
+	std::vector<char> frame;
+	CHECK( writeFrame( fds[0], writer.bytes ) );
+	CHECK( readFrame( fds[1], frame ) && frame == writer.bytes );
+	// Oversized frames are refused before anything is allocated
+	uint32_t length = maxFrameBytes + 1;
+	CHECK( writeAll( fds[0], reinterpret_cast<const char *>( &length ), sizeof( length ) ) );
+	CHECK( !readFrame( fds[1], frame ) );
+	close( fds[0] );
+	close( fds[1] );
+}
+
+// Start the daemon with the given options and return its pid
+static pid_t start( const char *daemon, std::vector<std::string> options )
+{
+	pid_t pid = fork();
+	if ( pid == 0 ) {
+		std::vector<char *> argv{ const_cast<char *>( daemon ) };
+		for ( auto &option : options ) {
+			argv.push_back( option.data() );
+		}
+		argv.push_back( nullptr );
+		execv( daemon, argv.data() );
+		_exit( 127 );
+	}
+	return pid;
+}
+
+// Exit status of the daemon, or -1 if it is still running after a few seconds
+static int finish( pid_t pid )
+{
+	for ( int i = 0; i < 500; ++i ) {
+		int status;
+		if ( waitpid( pid, &status, WNOHANG ) == pid ) {
+			return WIFEXITED( status ) ? WEXITSTATUS( status ) : -1;
+		}
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+	kill( pid, SIGKILL );
+	waitpid( pid, nullptr, 0 );
+	return -1;
+}
+
+static int connectTo( const char *path )
+{
+	sockaddr_un address{};
+	address.sun_family = AF_UNIX;
+	std::strcpy( address.sun_path, path );
+	for ( int i = 0; i < 500; ++i ) {
+		int fd = socket( AF_UNIX, SOCK_STREAM, 0 );
+		if ( connect( fd, reinterpret_cast<sockaddr *>( &address ), sizeof( address ) ) == 0 ) {
+			// A daemon that stops answering fails the test instead of hanging it
+			timeval timeout{ 10, 0 };
+			setsockopt( fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof( timeout ) );
+			return fd;
+		}
+		close( fd );
+		std::this_thread::sleep_for( std::chrono::milliseconds( 10 ) );
+	}
+	return -1;
+}
+
+// Send a request frame and return the reply frame, empty if there is none
+static std::vector<char> request( int fd, const FrameWriter &batch )
+{
+	std::vector<char> reply;
+	if ( !writeFrame( fd, batch.bytes ) || !readFrame( fd, reply ) ) {
+		reply.clear();
+	}
+	return reply;
+}
+
+static FrameReader reader( const std::vector<char> &reply )
+{
+	return { reply.data(), reply.data() + reply.size() };
+}
+
+static void edges( FrameWriter &batch, uint64_t first, uint32_t max )
+{
+	batch.put( DaemonOp::Edges );
+	batch.put( first );
+	batch.put( max );
+}
+
+// Read the header of an Edges result and skip its edges
+static bool readEdges( FrameReader &in, uint64_t &version, uint64_t &total, uint32_t &count )
+{
+	DaemonStatus status;
+	if ( !in.get( status ) || status != DaemonStatus::Ok || !in.get( version ) || !in.get( total ) || !in.get( count ) || in.remaining() < count * 4 * sizeof( double ) ) {
+		return false;
+	}
+	in.next += count * 4 * sizeof( double );
+	return true;
+}
+
+static void testDaemon( const char *daemon )
+{
+	CHECK( finish( start( daemon, { "--seed", "abc" } ) ) == 1 );
+	CHECK( finish( start( daemon, { "--generate", "1000,x" } ) ) == 1 );
+
+	const char *path = "daemon_test.sock";
+	pid_t pid = start( daemon, { "--socket", path, "--generate", "1000,1000,20,50" } );
+	int fd = connectTo( path );
+	CHECK( fd >= 0 );
+	if ( fd < 0 ) {
+		finish( pid );
+		return;
+	}
+
+	FrameWriter batch;
+	batch.put( DaemonOp::Info );
+	edges( batch, 0, 10 );
+	edges( batch, 10, 10 );
+	// A page past the end is invalid and the batch goes on
+	edges( batch, uint64_t( 1 ) << 40, 10 );
+	batch.put( DaemonOp::Locate );
+	batch.put( 500.5 );
+	batch.put( 500.5 );
+	batch.put( DaemonOp::Locate );
+	batch.put( -1.0 );
+	batch.put( 5.0 );
+	auto reply = request( fd, batch );
+	auto in = reader( reply );
+	DaemonStatus status;
+	double width = 0, height = 0;
+	uint32_t obstacles = 0, nets = 0;
+	CHECK( in.get( status ) && status == DaemonStatus::Ok );
+	CHECK( in.get( width ) && in.get( height ) && in.get( obstacles ) && in.get( nets ) );
+	CHECK( width == 1000 && height == 1000 && obstacles > 0 && nets > 0 );
+	uint64_t version, total, secondVersion, secondTotal;
+	uint32_t count;
+	CHECK( readEdges( in, version, total, count ) && count == 10 && total > 20 );
+	CHECK( readEdges( in, secondVersion, secondTotal, count ) && count == 10 );
+	CHECK( secondVersion == version && secondTotal == total );
+	CHECK( in.get( status ) && status == DaemonStatus::Invalid );
+	uint8_t free;
+	double corner;
+	CHECK( in.get( status ) && status == DaemonStatus::Ok && in.get( free ) );
+	for ( int i = 0; i < 6; ++i ) {
+		CHECK( in.get( corner ) );
+	}
+	CHECK( in.get( status ) && status == DaemonStatus::Invalid );
+	CHECK( in.done() );
+
+	// A second client that floods requests and never reads its replies does not hold up the first
+	int stalled = connectTo( path );
+	CHECK( stalled >= 0 );
+	FrameWriter flood;
+	edges( flood, 0, ~uint32_t( 0 ) );
+	std::vector<char> frames;
+	for ( int i = 0; i < 64; ++i ) {
+		uint32_t length = flood.bytes.size();
+		frames.insert( frames.end(), reinterpret_cast<const char *>( &length ), reinterpret_cast<const char *>( &length ) + sizeof( length ) );
+		frames.insert( frames.end(), flood.bytes.begin(), flood.bytes.end() );
+	}
+	CHECK( writeAll( stalled, frames.data(), frames.size() ) );
+
+	// Edits move the version; a point outside the die is refused
+	batch = {};
+	batch.put( DaemonOp::AddNet );
+	for ( double v : { 1.0, 1.0, 2000.0, 2.0 } ) {
+		batch.put( v );
+	}
+	batch.put( DaemonOp::AddNet );
+	for ( double v : { 3.0, 997.0, 996.0, 4.0 } ) {
+		batch.put( v );
+	}
+	edges( batch, 0, 1 );
+	batch.put( DaemonOp::Route );
+	batch.put( uint32_t( 1 ) );
+	batch.put( nets );
+	reply = request( fd, batch );
+	in = reader( reply );
+	uint32_t net, points;
+	CHECK( in.get( status ) && status == DaemonStatus::Invalid );
+	CHECK( in.get( status ) && status == DaemonStatus::Ok && in.get( net ) && net == nets );
+	CHECK( readEdges( in, secondVersion, secondTotal, count ) && count == 1 );
+	CHECK( secondVersion != version && secondTotal > total );
+	CHECK( in.get( status ) && status == DaemonStatus::Ok && in.get( points ) && points >= 2 );
+
+	// A malformed command ends the batch, the commands after it get no result
+	batch = {};
+	batch.put( DaemonOp::Locate );
+	batch.put( 1.0 );
+	batch.put( DaemonOp::Info );
+	reply = request( fd, batch );
+	in = reader( reply );
+	CHECK( in.get( status ) && status == DaemonStatus::Malformed && in.done() );
+	batch = {};
+	batch.put( DaemonOp::Route );
+	batch.put( ~uint32_t( 0 ) );
+	reply = request( fd, batch );
+	in = reader( reply );
+	CHECK( in.get( status ) && status == DaemonStatus::Malformed && in.done() );
+
+	batch = {};
+	batch.put( DaemonOp::Shutdown );
+	reply = request( fd, batch );
+	in = reader( reply );
+	CHECK( in.get( status ) && status == DaemonStatus::Ok );
+	CHECK( finish( pid ) == 0 );
+	close( fd );
+	close( stalled );
+}
+
+int main( int argc, char *argv[] )
+{
+	// The daemon may close a connection the test is still writing to
+	std::signal( SIGPIPE, SIG_IGN );
+	testFrames();
+	CHECK( argc > 1 );
+	if ( argc > 1 ) {
+		testDaemon( argv[1] );
+	}
+	return checkFailures() ? 1 : 0;
+}
@@ -0,0 +1,91 @@
+// DynamicCDT following a long run of edits: the published CDT matches a rebuild, removed nodes are recycled and
+// locate answers inside and outside the die
+#include "algo.h"
+#include "check.h"
+#include <cmath>
+#include <functional>
+#include <memory>
+
+// Nodes a triangulation of the graph needs at most: the corners of the die and the obstacles, the pins and the
+// super triangle
+static size_t liveNodes( const Graph &graph )
+{
+	return 4 * ( graph.getObstacles().size() + 1 ) + 2 * graph.getNets().size() + 3;
+}
+
+int main()
+{
+	std::unique_ptr<Graph> graph( generateRandomGraph( 1000, 1000, 40, 40, 3 ) );
+	DynamicCDT cdt( graph.get() );
+	TestRandom random{ 5 };
+	auto coordinate = [&] { return std::floor( random.uniform() * 999 ); };
+	// Edits are tried on a copy first, which has no listeners, and only applied when validateGraph accepts the result
+	auto valid = [&]( const std::function<void( Graph & )> &edit ) {
+		Graph trial( *graph );
+		edit( trial );
+		return validateGraph( trial, 0 ).valid();
+	};
+	size_t peak = liveNodes( *graph );
+	for ( int round = 0; round < 400; ++round ) {
+		TwoPoints net{ { coordinate(), coordinate() }, { coordinate(), coordinate() } };
+		if ( valid( [&]( Graph &trial ) { trial.addNet( net ); } ) ) {
+			graph->addNet( net );
+		}
+		if ( round % 3 == 0 ) {
+			double x = coordinate(), y = coordinate();
+			TwoPoints obstacle{ { x, y }, { x + 1, y + 1 } };
+			if ( valid( [&]( Graph &trial ) { trial.addObstacle( obstacle ); } ) ) {
+				graph->addObstacle( obstacle );
+			}
+		}
+		if ( round % 5 == 0 ) {
+			int index = random.next() % graph->getObstacles().size();
+			auto [p1, p2] = graph->getObstacles()[index];
+			double dx = std::floor( random.uniform() * 5 ) - 2;
+			TwoPoints moved{ { std::get<0>( p1 ) + dx, std::get<1>( p1 ) }, { std::get<0>( p2 ) + dx, std::get<1>( p2 ) } };
+			if ( valid( [&]( Graph &trial ) { trial.moveObstacle( index, moved ); } ) ) {
+				graph->moveObstacle( index, moved );
+			}
+		}
+		peak = std::max( peak, liveNodes( *graph ) );
+		if ( graph->getNets().size() > 50 ) {
+			graph->removeNet( random.next() % graph->getNets().size() );
+		}
+		if ( graph->getObstacles().size() > 45 ) {
+			graph->removeObstacle( random.next() % graph->getObstacles().size() );
+		}
+	}
+	CHECK( validateGraph( *graph ).valid() );
+	// Freed nodes are reused, so the arrays never outgrow the largest graph seen
+	CHECK( cdt.nodeCapacity() <= peak );
+
+	cdt.publish();
+	Graph rebuilt( *graph );
+	CHECK( constructCDT( &rebuilt ) );
+	// Cocircular pins may get other diagonals, the number of edges of the domain is fixed
+	CHECK( graph->getCdtEdges().size() == rebuilt.getCdtEdges().size() );
+
+	for ( auto [p1, p2] : graph->getNets() ) {
+		auto [x, y] = p1;
+		auto face = cdt.locate( x, y );
+		CHECK( face.free );
+		bool corner = false;
+		for ( auto [cx, cy] : face.corners ) {
+			corner = corner || ( cx == x && cy == y );
+		}
+		CHECK( corner );
+	}
+	auto outside = cdt.locate( -1e12, 5 );
+	CHECK( !outside.free );
+
+	// With everything removed only the die is left, two triangles
+	while ( !graph->getNets().empty() ) {
+		graph->removeNet( 0 );
+	}
+	while ( !graph->getObstacles().empty() ) {
+		graph->removeObstacle( 0 );
+	}
+	cdt.publish();
+	CHECK( graph->getCdtEdges().size() == 5 );
+	return checkFailures() ? 1 : 0;
+}
@@ -0,0 +1,124 @@
+// Exact predicates on near-degenerate input, and the batch kernels of geometry.h against their plain definitions
+#include "check.h"
+#include "geometry.h"
+#include "predicates.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+static int sign( double value )
+{
+	return ( value > 0 ) - ( value < 0 );
+}
+
+static void testOrient2d()
+{
+	CHECK( orient2d( 0, 0, 1, 0, 0, 1 ) > 0 );
+	CHECK( orient2d( 0, 0, 0, 1, 1, 0 ) < 0 );
+	CHECK( orient2d( 0, 0, 1, 1, 2, 2 ) == 0 );
+	// a moved by ( i, j ) units of 2^-53 off the line through b and c: the exact orientation is 12 ( j - i ) units,
+	// which the plain double formula gets wrong for many of these
+	const double unit = std::ldexp( 1.0, -53 );
+	for ( int i = 0; i < 64; ++i ) {
+		for ( int j = 0; j < 64; ++j ) {
+			double ax = 0.5 + i * unit, ay = 0.5 + j * unit;
+			CHECK( sign( orient2d( ax, ay, 12, 12, 24, 24 ) ) == sign( j - i ) );
+		}
+	}
+}
+
+static void testIncircle()
+{
+	// The circle through three corners of the unit square passes through the fourth
+	CHECK( incircle( 0, 0, 1, 0, 1, 1, 0, 1 ) == 0 );
+	CHECK( incircle( 0, 0, 1, 0, 1, 1, 0.5, 0.5 ) > 0 );
+	CHECK( incircle( 0, 0, 1, 0, 1, 1, 2, 2 ) < 0 );
+	// Three points on an ellipse and a fourth on their circumcircle, up to rounding. The determinant is antisymmetric,
+	// so over every order of the points its sign follows the parity of the order; the plain double formula breaks
+	// this for most of these quadruples.
+	TestRandom random{ 5 };
+	for ( int round = 0; round < 200; ++round ) {
+		double x[4], y[4];
+		for ( int k = 0; k < 3; ++k ) {
+			double angle = random.uniform() * 2 * std::acos( -1.0 );
+			x[k] = 0.1 + 0.9 * std::cos( angle ), y[k] = 0.3 + 1.1 * std::sin( angle );
+		}
+		double d = 2 * ( x[0] * ( y[1] - y[2] ) + x[1] * ( y[2] - y[0] ) + x[2] * ( y[0] - y[1] ) );
+		double l0 = x[0] * x[0] + y[0] * y[0], l1 = x[1] * x[1] + y[1] * y[1], l2 = x[2] * x[2] + y[2] * y[2];
+		double cx = ( l0 * ( y[1] - y[2] ) + l1 * ( y[2] - y[0] ) + l2 * ( y[0] - y[1] ) ) / d;
+		double cy = ( l0 * ( x[2] - x[1] ) + l1 * ( x[0] - x[2] ) + l2 * ( x[1] - x[0] ) ) / d;
+		double radius = std::hypot( x[0] - cx, y[0] - cy ), angle = random.uniform() * 2 * std::acos( -1.0 );
+		x[3] = cx + radius * std::cos( angle ), y[3] = cy + radius * std::sin( angle );
+		int order[4] = { 0, 1, 2, 3 }, expected = 2;
+		do {
+			int inversions = 0;
+			for ( int i = 0; i < 4; ++i ) {
+				for ( int j = i + 1; j < 4; ++j ) {
+					inversions += order[i] > order[j];
+				}
+			}
+			auto [a, b, c, e] = order;
+			int s = sign( incircle( x[a], y[a], x[b], y[b], x[c], y[c], x[e], y[e] ) ) * ( inversions % 2 ? -1 : 1 );
+			if ( expected == 2 ) {
+				expected = s;
+			}
+			CHECK( s == expected );
+		} while ( std::next_permutation( order, order + 4 ) );
+	}
+}
+
+static void testKernels()
+{
+	TestRandom random{ 1 };
+	// An odd count leaves a remainder after the four-wide steps
+	const size_t count = 37;
+	std::vector<double> x( count ), y( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		x[i] = random.uniform() * 1000, y[i] = random.uniform() * 1000;
+	}
+	std::vector<double> dx = x, dy = y;
+	divideCoordinates( dx.data(), dy.data(), count, 3 );
+	std::vector<double> mx = dx, my = dy;
+	multiplyCoordinates( mx.data(), my.data(), count, 7 );
+	for ( size_t i = 0; i < count; ++i ) {
+		CHECK( dx[i] == x[i] / 3 && dy[i] == y[i] / 3 );
+		CHECK( mx[i] == dx[i] * 7 && my[i] == dy[i] * 7 );
+	}
+
+	const int ndiv = 8;
+	std::vector<double> ux( count ), uy( count );
+	std::vector<int> key( count );
+	for ( size_t i = 0; i < count; ++i ) {
+		ux[i] = x[i] / 1000, uy[i] = y[i] / 1000;
+	}
+	binKeys( ux.data(), uy.data(), key.data(), count, ndiv, ndiv * 0.999 );
+	for ( size_t i = 0; i < count; ++i ) {
+		int row = uy[i] * ndiv * 0.999, column = ux[i] * ndiv * 0.999;
+		CHECK( key[i] == ( row & 1 ? row * ndiv + column + 1 : ( row + 1 ) * ndiv - column ) );
+	}
+
+	RectBuffer rects;
+	for ( int i = 0; i < 11; ++i ) {
+		rects.push( { i * 10.0, 0, i * 10.0 + 5, 5 } );
+	}
+	for ( size_t i = 0; i < count; ++i ) {
+		double px = x[i] / 9, py = y[i] / 200;
+		bool expected = false;
+		for ( size_t r = 2; r < rects.size(); ++r ) {
+			expected = expected || rects[r].contains( px, py );
+		}
+		CHECK( anyContains( rects, 2, rects.size(), px, py ) == expected );
+	}
+	// Borders are not contained
+	CHECK( !anyContains( rects, 0, rects.size(), 5, 2 ) );
+	CHECK( anyContains( rects, 0, rects.size(), 4, 2 ) );
+}
+
+int main()
+{
+	testOrient2d();
+	testIncircle();
+	testKernels();
+	return checkFailures() ? 1 : 0;
+}
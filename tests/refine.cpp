@@ -0,0 +1,81 @@
+// Delaunay refinement on a fixed layout: angle and area targets are met by every free triangle, and angle bounds
+// past RefineOptions::maxMinAngle are clamped
+#include "cdt.h"
+#include "check.h"
+#include <algorithm>
+#include <cmath>
+
+static Graph layout()
+{
+	return Graph( 100, 100, { { { 20, 20 }, { 40, 30 } }, { { 60, 50 }, { 70, 90 } }, { { 10, 70 }, { 30, 75 } } },
+				  { { { 5, 5 }, { 95, 95 } }, { { 50, 10 }, { 80, 40 } }, { { 45, 60 }, { 90, 20 } } } );
+}
+
+// Refine the layout and return the smallest angle, in degrees, and the largest area of its free triangles
+static void refineLayout( const RefineOptions &refine, CDTStats &stats, double &minAngle, double &maxArea )
+{
+	Graph graph = layout();
+	CDTOptions options;
+	options.refine = refine;
+	CDTHelper cdt( &graph, &stats, options );
+	CHECK( cdt.construct() );
+	minAngle = 180, maxArea = 0;
+	auto &mesh = cdt.mesh;
+	for ( unsigned t = 1; t <= mesh.last(); ++t ) {
+		unsigned v[3] = { mesh.vertex( t, 0 ), mesh.vertex( t, 1 ), mesh.vertex( t, 2 ) };
+		if ( mesh.isHole( t ) || cdt.isSuper( v[0] ) || cdt.isSuper( v[1] ) || cdt.isSuper( v[2] ) ) {
+			continue;
+		}
+		for ( int i = 0; i < 3; ++i ) {
+			auto [ax, ay] = cdt.cdt_graph.nodes[v[i]];
+			auto [bx, by] = cdt.cdt_graph.nodes[v[( i + 1 ) % 3]];
+			auto [cx, cy] = cdt.cdt_graph.nodes[v[( i + 2 ) % 3]];
+			double angle = std::atan2( std::abs( ( bx - ax ) * ( cy - ay ) - ( by - ay ) * ( cx - ax ) ), ( bx - ax ) * ( cx - ax ) + ( by - ay ) * ( cy - ay ) );
+			minAngle = std::min( minAngle, angle * 180 / std::acos( -1.0 ) );
+			if ( i == 0 ) {
+				maxArea = std::max( maxArea, std::abs( ( bx - ax ) * ( cy - ay ) - ( by - ay ) * ( cx - ax ) ) / 2 );
+			}
+		}
+	}
+}
+
+int main()
+{
+	CDTStats plain;
+	double minAngle, maxArea;
+	refineLayout( {}, plain, minAngle, maxArea );
+	CHECK( plain.steiner == 0 );
+
+	RefineOptions angle;
+	angle.minAngle = 25;
+	CDTStats angled;
+	refineLayout( angle, angled, minAngle, maxArea );
+	CHECK( angled.steiner > 0 );
+	CHECK( angled.nodes == plain.nodes + angled.steiner );
+	CHECK( minAngle >= 25 - 1e-9 );
+
+	RefineOptions area;
+	area.maxArea = 20;
+	CDTStats sized;
+	refineLayout( area, sized, minAngle, maxArea );
+	CHECK( sized.steiner > 0 );
+	CHECK( maxArea <= 20 );
+
+	// Past the bound refinement may not finish, so larger angles refine exactly like the bound
+	RefineOptions bound, steep;
+	bound.minAngle = RefineOptions::maxMinAngle;
+	steep.minAngle = 45;
+	CDTStats atBound, clamped;
+	refineLayout( bound, atBound, minAngle, maxArea );
+	CHECK( minAngle >= RefineOptions::maxMinAngle - 1e-9 );
+	refineLayout( steep, clamped, minAngle, maxArea );
+	CHECK( clamped.steiner == atBound.steiner );
+	CHECK( clamped.edges == atBound.edges );
+
+	RefineOptions capped = angle;
+	capped.maxSteiner = 5;
+	CDTStats limited;
+	refineLayout( capped, limited, minAngle, maxArea );
+	CHECK( limited.steiner <= 5 );
+	return checkFailures() ? 1 : 0;
+}
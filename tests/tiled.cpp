@@ -0,0 +1,59 @@
+// Tiled construction writes the same CDT edges as constructCDT, whatever the tiles and margins, and reports its
+// stitch
+#include "algo.h"
+#include "check.h"
+#include "layout.h"
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Edges with their lower end first, sorted, so two edge lists can be compared as sets
+static std::vector<TwoPoints> normalized( std::vector<TwoPoints> edges )
+{
+	for ( auto &[p1, p2] : edges ) {
+		if ( p2 < p1 ) {
+			std::swap( p1, p2 );
+		}
+	}
+	std::sort( edges.begin(), edges.end() );
+	return edges;
+}
+
+int main()
+{
+	// A die that is not square and not a whole number of tiles
+	std::unique_ptr<Graph> graph( generateRandomGraph( 2000, 1500, 60, 300, 9 ) );
+	Graph reference( *graph );
+	CHECK( constructCDT( &reference ) );
+	auto expected = normalized( reference.getCdtEdges() );
+
+	const char *path = "tiled_test.layout";
+	size_t stitchNodes[2] = {};
+	double margins[2] = { 0.25, 0.05 };
+	for ( int run = 0; run < 2; ++run ) {
+		TiledCDTOptions options;
+		options.tileSize = 450;
+		options.margin = margins[run];
+		TiledCDTStats stats;
+		CHECK( constructCDTTiled( *graph, path, &stats, options ) );
+		CHECK( stats.tiles == 5 * 4 );
+		CHECK( stats.tileTriangles > 0 && stats.stitchTriangles > 0 );
+		CHECK( stats.maxTileNodes < stats.cdt.nodes );
+		stitchNodes[run] = stats.stitchNodes;
+
+		std::unique_ptr<Graph> written( loadGraph( path ) );
+		CHECK( written != nullptr );
+		if ( written ) {
+			CHECK( written->getObstacles() == graph->getObstacles() );
+			CHECK( written->getNets() == graph->getNets() );
+			CHECK( normalized( written->getCdtEdges() ) == expected );
+		}
+	}
+	// Triangles that do not fit in a thin margin are left to the stitch
+	CHECK( stitchNodes[1] > stitchNodes[0] );
+	std::remove( path );
+
+	CHECK( !constructCDTTiled( *graph, "missing-directory/tiled_test.layout" ) );
+	return checkFailures() ? 1 : 0;
+}
@@ -0,0 +1,120 @@
+// validateGraph on a layout with one of every issue and against brute force on random layouts, and repairGraph
+// making each of them acceptable to constructCDT
+#include "algo.h"
+#include "check.h"
+#include "geometry.h"
+#include <cmath>
+#include <memory>
+
+static Rect rect( const TwoPoints &obstacle )
+{
+	auto [p1, p2] = obstacle;
+	return { std::get<0>( p1 ), std::get<1>( p1 ), std::get<0>( p2 ), std::get<1>( p2 ) };
+}
+
+static void testIssues()
+{
+	using Kind = GraphIssue::Kind;
+	double nan = std::nan( "" );
+	Graph graph( 100, 100,
+				 { { { 0, 0 }, { 10, 10 } }, { { 5, 5 }, { 15, 15 } }, { { 10, 0 }, { 20, 5 } }, { { 30, 30 }, { 30, 40 } }, { { 90, 90 }, { 110, 95 } },
+				   { { 14, 14 }, { 40, 20 } }, { { 50, 50 }, { 60, 60 } }, { { nan, 1 }, { 3, 3 } } },
+				 { { { 1, 1 }, { 50, 55 } }, { { 20, 2 }, { 70, 70 } }, { { 70, 70 }, { 20, 2 } }, { { 80, 80 }, { 80, 80 } }, { { -5, 50 }, { 50, 50 } }, { { 60, 52 }, { 45, 45 } } } );
+	auto report = validateGraph( graph );
+	CHECK( !report.valid() );
+	// Obstacle 7 is not a number, so both out of the die and empty; 2 only touches 0 and 1
+	CHECK( report.count( Kind::ObstacleOutOfBounds ) == 2 );
+	CHECK( report.count( Kind::EmptyObstacle ) == 2 );
+	CHECK( report.count( Kind::OverlappingObstacles ) == 2 );
+	CHECK( report.count( Kind::PinOutOfBounds ) == 1 );
+	CHECK( report.count( Kind::PinInsideObstacle ) == 1 );
+	// On a side or a corner: pins 2 and 5 on obstacle 2, pins 1, 9 and 10 on obstacle 6
+	CHECK( report.count( Kind::PinOnObstacle ) == 5 );
+	CHECK( report.count( Kind::DegenerateNet ) == 1 );
+	// Net 2 is net 1 reversed
+	CHECK( report.count( Kind::DuplicateNet ) == 1 );
+	CHECK( report.issues.size() == 15 );
+	bool overlap = false, inside = false, duplicate = false;
+	for ( auto issue : report.issues ) {
+		overlap = overlap || ( issue.kind == Kind::OverlappingObstacles && issue.item == 1 && issue.other == 5 );
+		inside = inside || ( issue.kind == Kind::PinInsideObstacle && issue.item == 0 && issue.other == 0 );
+		duplicate = duplicate || ( issue.kind == Kind::DuplicateNet && issue.item == 2 && issue.other == 1 );
+	}
+	CHECK( overlap && inside && duplicate );
+
+	// The list stops at the limit, the counts do not
+	auto limited = validateGraph( graph, 3 );
+	CHECK( limited.issues.size() == 3 );
+	CHECK( limited.counts == report.counts );
+
+	RepairStats stats;
+	std::unique_ptr<Graph> repaired( repairGraph( graph, &stats ) );
+	CHECK( validateGraph( *repaired ).valid() );
+	CHECK( stats.clampedObstacles == 1 && stats.droppedObstacles == 2 && stats.mergedObstacles == 3 );
+	CHECK( stats.clampedPins == 1 && stats.movedPins == 6 && stats.droppedNets == 2 );
+	// 0, 1, 2 and 5 become their bounding box, 4 is clipped to the die
+	CHECK( repaired->getObstacles().size() == 3 );
+	CHECK( repaired->getNets().size() == 4 );
+	bool merged = false, clipped = false;
+	for ( const auto &obstacle : repaired->getObstacles() ) {
+		Rect r = rect( obstacle );
+		merged = merged || ( r.x1 == 0 && r.y1 == 0 && r.x2 == 40 && r.y2 == 20 );
+		clipped = clipped || ( r.x1 == 90 && r.y1 == 90 && r.x2 == 100 && r.y2 == 95 );
+	}
+	CHECK( merged && clipped );
+	CHECK( constructCDT( repaired.get() ) );
+}
+
+// Overlaps and blocked pins on a grid, where sides and corners often coincide, counted by brute force
+static void testRandom()
+{
+	TestRandom random{ 7 };
+	auto grid = [&] { return static_cast<double>( random.next() % 21 * 5 ); };
+	for ( int round = 0; round < 200; ++round ) {
+		std::vector<TwoPoints> obstacles, nets;
+		int count = 1 + random.next() % 40;
+		for ( int i = 0; i < count; ++i ) {
+			double x = grid(), y = grid();
+			obstacles.push_back( { { x, y }, { x + 5 * ( 1 + random.next() % 4 ), y + 5 * ( 1 + random.next() % 4 ) } } );
+		}
+		for ( int i = 0; i < 30; ++i ) {
+			nets.push_back( { { grid(), grid() }, { grid(), grid() } } );
+		}
+		Graph graph( 100, 100, obstacles, nets );
+		auto report = validateGraph( graph, 0 );
+		size_t overlapping = 0, inside = 0, on = 0;
+		for ( int i = 0; i < count; ++i ) {
+			for ( int j = i + 1; j < count; ++j ) {
+				overlapping += rect( obstacles[i] ).intersects( rect( obstacles[j] ) );
+			}
+		}
+		for ( auto [p1, p2] : nets ) {
+			for ( auto [x, y] : { p1, p2 } ) {
+				for ( const auto &obstacle : obstacles ) {
+					Rect r = rect( obstacle );
+					if ( r.contains( x, y ) ) {
+						++inside;
+					} else if ( x >= r.x1 && x <= r.x2 && y >= r.y1 && y <= r.y2 ) {
+						++on;
+					}
+				}
+			}
+		}
+		CHECK( report.count( GraphIssue::Kind::OverlappingObstacles ) == overlapping );
+		CHECK( report.count( GraphIssue::Kind::PinInsideObstacle ) == inside );
+		CHECK( report.count( GraphIssue::Kind::PinOnObstacle ) == on );
+
+		std::unique_ptr<Graph> repaired( repairGraph( graph ) );
+		CHECK( validateGraph( *repaired ).valid() );
+		CHECK( constructCDT( repaired.get() ) );
+	}
+}
+
+int main()
+{
+	testIssues();
+	testRandom();
+	std::unique_ptr<Graph> generated( generateRandomGraph( 1000, 1000, 100, 100, 1 ) );
+	CHECK( validateGraph( *generated ).valid() );
+	return checkFailures() ? 1 : 0;
+}